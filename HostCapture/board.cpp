@@ -0,0 +1,184 @@
+/******************************************************************************
+* SuperAudioBoard host capture tool
+*
+* board.cpp
+*
+* Host side of the sine test command protocol.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#include "board.h"
+
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+#include "capture_reader.h"
+#include "rice_decoder.h"
+#include "../SineTestCode/compress.h"
+
+Board::Board(SerialPort &port) : port(port)
+{
+}
+
+std::string Board::command(const std::string &cmd, int timeoutMs)
+{
+	std::string reply;
+
+	port.writeLine(cmd);
+	reply = port.readLine(timeoutMs);
+
+	if(reply.compare(0, 2, "OK") == 0)
+		return (reply.size() > 3) ? reply.substr(3) : std::string();
+	if(reply.compare(0, 3, "ERR") == 0)
+		throw std::runtime_error(cmd + ": " + reply);
+	throw std::runtime_error(cmd + ": unexpected reply \"" + reply + "\"");
+}
+
+BoardStatus Board::status()
+{
+	std::istringstream in(command("STAT"));
+	BoardStatus st;
+	int init, valid;
+
+	if(!(in >> init >> valid >> st.runs >> st.channel >> st.samples))
+		throw std::runtime_error("STAT: can't parse reply");
+	if(!(in >> st.board))
+		st.board = 0;
+	st.initialized = (init != 0);
+	st.dataValid = (valid != 0);
+	return st;
+}
+
+unsigned Board::init()
+{
+	// Codec setup plus up to 10s for the ADC high pass filter to settle
+	return std::strtoul(command("INIT", 30000).c_str(), NULL, 10);
+}
+
+void Board::configure(unsigned runs, char channel)
+{
+	std::ostringstream cmd;
+
+	cmd << "CFG RUNS " << runs;
+	command(cmd.str());
+	command(std::string("CFG CH ") + channel);
+}
+
+void Board::selectBoard(unsigned board)
+{
+	std::ostringstream cmd;
+
+	cmd << "CFG BOARD " << board;
+	command(cmd.str());
+}
+
+unsigned Board::run(const BoardStatus &st)
+{
+	// One extra run is thrown away on the board, then allow plenty of slack
+	unsigned long ms = (unsigned long)(st.runs + 1) * st.samples * 1000 / BOARD_SAMPLE_RATE;
+
+	return std::strtoul(command("RUN", ms + 5000).c_str(), NULL, 10);
+}
+
+void Board::fetch(std::vector<int32_t> &left, std::vector<int32_t> &right)
+{
+	CaptureReader reader(port);
+	const std::vector<uint8_t> *block;
+	std::vector<int32_t> sums;
+	size_t bytes, i;
+
+	bytes = std::strtoul(command("GET").c_str(), NULL, 10);
+	if((bytes == 0) || (bytes % 8))
+		throw std::runtime_error("GET: bad length");
+
+	// Blocks are a multiple of 4 bytes long, so samples never straddle two
+	sums.reserve(bytes / 4);
+	reader.start(bytes);
+	while((block = reader.acquire()) != NULL)
+	{
+		for(i = 0; i + 4 <= block->size(); i += 4)
+		{
+			const uint8_t *p = block->data() + i;
+			sums.push_back((int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+				((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24)));
+		}
+		reader.release();
+	}
+
+	// The board sends the right channel first
+	right.assign(sums.begin(), sums.begin() + sums.size() / 2);
+	left.assign(sums.begin() + sums.size() / 2, sums.end());
+}
+
+size_t Board::fetchCompressed(std::vector<int32_t> &left, std::vector<int32_t> &right)
+{
+	uint8_t hdr[COMPRESS_FRAME_HDR_LEN];
+	std::vector<uint8_t> payload;
+	size_t samples, done, total, len, n;
+
+	samples = std::strtoul(command("GET RICE").c_str(), NULL, 10);
+	right.assign(samples, 0);
+	left.assign(samples, 0);
+
+	// Frames until the empty one at the end, right channel first
+	done = 0;
+	total = 0;
+	while(1)
+	{
+		port.readExact(hdr, sizeof(hdr), 2000);
+		total += sizeof(hdr);
+		len = hdr[0] | (hdr[1] << 8);
+		n = hdr[2] | (hdr[3] << 8);
+		if((len == 0) && (n == 0))
+			break;
+		if(n > samples - done)
+			throw std::runtime_error("GET RICE: more samples than announced");
+
+		payload.resize(len);
+		port.readExact(payload.data(), len, 2000);
+		total += len;
+
+		decodeFrame(payload.data(), len, n, &right[done], &left[done]);
+		done += n;
+	}
+	if(done != samples)
+		throw std::runtime_error("GET RICE: stream ended early");
+
+	return total;
+}
+
+uint8_t Board::readRegister(unsigned reg)
+{
+	std::ostringstream cmd;
+
+	cmd << "RR " << reg;
+	return (uint8_t)std::strtoul(command(cmd.str()).c_str(), NULL, 0);
+}
+
+void Board::writeRegister(unsigned reg, uint8_t val)
+{
+	std::ostringstream cmd;
+
+	cmd << "RW " << reg << " " << (unsigned)val;
+	command(cmd.str());
+}
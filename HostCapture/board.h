@@ -0,0 +1,88 @@
+/******************************************************************************
+* SuperAudioBoard host capture tool
+*
+* board.h
+*
+* Host side of the sine test command protocol.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "serial_port.h"
+
+// Sample rate the sine test runs at
+#define BOARD_SAMPLE_RATE 48000
+
+struct BoardStatus
+{
+	bool initialized;
+	bool dataValid;
+	unsigned runs;
+	char channel;		// 'L', 'R' or 'B'
+	unsigned samples;	// per channel
+	unsigned board;		// board RUN captures (0 on older firmware)
+};
+
+// The sine test's line command protocol (see SineTestCode/sine_test.c).
+// Every command gets one "OK ..." or "ERR ..." line back; an ERR reply
+// or a timeout throws std::runtime_error.
+class Board
+{
+public:
+	explicit Board(SerialPort &port);
+
+	// Send cmd and return whatever followed "OK" in the reply
+	std::string command(const std::string &cmd, int timeoutMs = 2000);
+
+	BoardStatus status();
+	// Set up the codec.  Returns how long the board took to get valid
+	// samples, in ms.
+	unsigned init();
+	void configure(unsigned runs, char channel);
+
+	// Pick the board to capture from when there's more than one
+	void selectBoard(unsigned board);
+
+	// Run one test.  Returns the time the board reported, in ms.
+	unsigned run(const BoardStatus &st);
+
+	// Fetch the last test's per-sample sums using the binary GET
+	void fetch(std::vector<int32_t> &left, std::vector<int32_t> &right);
+
+	// Same, using the compressed GET RICE.  Returns the number of bytes
+	// that came over the link.
+	size_t fetchCompressed(std::vector<int32_t> &left, std::vector<int32_t> &right);
+
+	uint8_t readRegister(unsigned reg);
+	void writeRegister(unsigned reg, uint8_t val);
+
+private:
+	SerialPort &port;
+};
+
+#endif
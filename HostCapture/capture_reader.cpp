@@ -0,0 +1,143 @@
+/******************************************************************************
+* SuperAudioBoard host capture tool
+*
+* capture_reader.cpp
+*
+* Double buffered background reader for binary capture data.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#include "capture_reader.h"
+
+#include <stdexcept>
+
+CaptureReader::CaptureReader(SerialPort &port, size_t blockSize, int timeoutMs)
+	: port(port), blockSize(blockSize), timeoutMs(timeoutMs), remaining(0),
+	fillIdx(0), readIdx(0), done(true), quit(false)
+{
+	ready[0] = ready[1] = false;
+}
+
+CaptureReader::~CaptureReader()
+{
+	stop();
+}
+
+void CaptureReader::stop()
+{
+	if(thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		cond.notify_all();
+		thread.join();
+	}
+}
+
+void CaptureReader::start(size_t totalBytes)
+{
+	stop();
+
+	remaining = totalBytes;
+	ready[0] = ready[1] = false;
+	fillIdx = readIdx = 0;
+	done = false;
+	quit = false;
+	error.clear();
+
+	thread = std::thread(&CaptureReader::run, this);
+}
+
+void CaptureReader::run()
+{
+	std::vector<uint8_t> *buf;
+	size_t len, got, n;
+
+	while(remaining > 0)
+	{
+		// Wait for the caller to hand this buffer back
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [this] { return !ready[fillIdx] || quit; });
+			if(quit)
+				return;
+		}
+
+		// Only this thread touches the buffer until it's marked ready
+		buf = &buffers[fillIdx];
+		len = (remaining < blockSize) ? remaining : blockSize;
+		buf->resize(len);
+		got = 0;
+		try
+		{
+			while(got < len)
+			{
+				n = port.read(buf->data() + got, len - got, timeoutMs);
+				if(n == 0)
+					throw std::runtime_error("timeout reading capture data from " + port.path());
+				got += n;
+			}
+		}
+		catch(const std::exception &e)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			error = e.what();
+			done = true;
+			cond.notify_all();
+			return;
+		}
+		remaining -= len;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			ready[fillIdx] = true;
+			fillIdx ^= 1;
+			if(remaining == 0)
+				done = true;
+		}
+		cond.notify_all();
+	}
+}
+
+const std::vector<uint8_t> *CaptureReader::acquire()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	cond.wait(lock, [this] { return ready[readIdx] || done; });
+	if(ready[readIdx])
+		return &buffers[readIdx];
+	if(!error.empty())
+		throw std::runtime_error(error);
+	return NULL;
+}
+
+void CaptureReader::release()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ready[readIdx] = false;
+		readIdx ^= 1;
+	}
+	cond.notify_all();
+}
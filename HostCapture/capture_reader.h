@@ -0,0 +1,86 @@
+/******************************************************************************
+* SuperAudioBoard host capture tool
+*
+* capture_reader.h
+*
+* Double buffered background reader for binary capture data.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#ifndef CAPTURE_READER_H
+#define CAPTURE_READER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "serial_port.h"
+
+// Reads a binary stream of known length from the port on a background
+// thread, double buffered: while the caller works on one block the thread
+// is already filling the other, so the USB link never waits on file I/O
+// or decoding.
+class CaptureReader
+{
+public:
+	CaptureReader(SerialPort &port, size_t blockSize = 16384, int timeoutMs = 2000);
+	~CaptureReader();
+
+	// Start reading totalBytes
+	void start(size_t totalBytes);
+
+	// Wait for the next full block (the last one may be short).  Returns
+	// NULL at the end of the stream, and throws if the reader failed.
+	// The block stays valid until release().
+	const std::vector<uint8_t> *acquire();
+	void release();
+
+	CaptureReader(const CaptureReader &) = delete;
+	CaptureReader &operator=(const CaptureReader &) = delete;
+
+private:
+	void run();
+	void stop();
+
+	SerialPort &port;
+	size_t blockSize;
+	int timeoutMs;
+	size_t remaining;
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cond;
+
+	std::vector<uint8_t> buffers[2];
+	bool ready[2];
+	unsigned fillIdx;
+	unsigned readIdx;
+	bool done;
+	bool quit;
+	std::string error;
+};
+
+#endif
@@ -0,0 +1,111 @@
+/******************************************************************************
+* SuperAudioBoard host capture tool
+*
+* rice_decoder.cpp
+*
+* Decoder for the compressed capture stream sent by "GET RICE".
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#include "rice_decoder.h"
+
+#include <stdexcept>
+
+#include "../SineTestCode/compress.h"
+
+namespace
+{
+
+class BitReader
+{
+public:
+	BitReader(const uint8_t *data, size_t len) : data(data), len(len), pos(0)
+	{
+	}
+
+	uint32_t bit()
+	{
+		if(pos >= len * 8)
+			throw std::runtime_error("compressed frame is truncated");
+		uint32_t b = (data[pos >> 3] >> (7 - (pos & 7))) & 1;
+		pos++;
+		return b;
+	}
+
+	uint32_t bits(unsigned n)
+	{
+		uint32_t v = 0;
+
+		while(n--)
+			v = (v << 1) | bit();
+		return v;
+	}
+
+private:
+	const uint8_t *data;
+	size_t len;
+	size_t pos;
+};
+
+void decodeChannel(BitReader &br, unsigned n, int32_t *x)
+{
+	unsigned order, k, i, q;
+	uint32_t u, e;
+
+	order = br.bits(2);
+	k = br.bits(5);
+	if(order > COMPRESS_MAX_ORDER)
+		throw std::runtime_error("bad predictor order in compressed frame");
+
+	for(i = 0; (i < order) && (i < n); i++)
+		x[i] = (int32_t)br.bits(32);
+
+	for(i = order; i < n; i++)
+	{
+		q = 0;
+		while((q < COMPRESS_RICE_ESC) && !br.bit())
+			q++;
+		if(q == COMPRESS_RICE_ESC)
+			u = br.bits(32);
+		else
+			u = (q << k) | br.bits(k);
+
+		// Undo the zigzag mapping and the prediction, modulo 2^32
+		e = (u >> 1) ^ (0 - (u & 1));
+		if(order == 1)
+			e += (uint32_t)x[i - 1];
+		else if(order == 2)
+			e += 2*(uint32_t)x[i - 1] - (uint32_t)x[i - 2];
+		x[i] = (int32_t)e;
+	}
+}
+
+}
+
+void decodeFrame(const uint8_t *payload, size_t len, unsigned n,
+	int32_t *ch0, int32_t *ch1)
+{
+	BitReader br(payload, len);
+
+	decodeChannel(br, n, ch0);
+	decodeChannel(br, n, ch1);
+}
@@ -0,0 +1,41 @@
+/******************************************************************************
+* SuperAudioBoard host capture tool
+*
+* rice_decoder.h
+*
+* Decoder for the compressed capture stream sent by "GET RICE".
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#ifndef RICE_DECODER_H
+#define RICE_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Decode one frame payload (format described in SineTestCode/compress.h)
+// holding n samples of each channel.  Throws std::runtime_error if the
+// payload is malformed.
+void decodeFrame(const uint8_t *payload, size_t len, unsigned n,
+	int32_t *ch0, int32_t *ch1);
+
+#endif
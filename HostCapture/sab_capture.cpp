@@ -0,0 +1,195 @@
+/******************************************************************************
+* SuperAudioBoard host capture tool
+*
+* sab_capture.cpp
+*
+* Runs sine tests on the board and saves the results.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "board.h"
+#include "serial_port.h"
+#include "writers.h"
+
+static void usage(void)
+{
+	std::cerr <<
+		"usage: sab_capture -d <device> [options] <output file>\n"
+		"  -d <device>     board serial port (e.g. /dev/ttyACM0) or the pty\n"
+		"                  printed by sab_emulator\n"
+		"  -f wav|raw|csv  output format (default: from the file extension)\n"
+		"  -n <runs>       runs summed per test, 1 to 255 (default 255)\n"
+		"  -c L|R|B        channel to play the sine on (default R)\n"
+		"  -b <board>      board to capture with more than one on the\n"
+		"                  bus (default: whatever the board has set)\n"
+		"  -i              send INIT first (codec setup, up to 10s)\n"
+		"  -r <count>      run count tests back to back, writing\n"
+		"                  <name>_0001.<ext>, <name>_0002.<ext>, ...\n"
+		"  -z              fetch the results compressed (GET RICE)\n";
+}
+
+static std::string isoDate(void)
+{
+	char buf[32];
+	time_t now = time(NULL);
+	struct tm tm;
+
+	gmtime_r(&now, &tm);
+	strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &tm);
+	return buf;
+}
+
+// name.ext -> name_0001.ext
+static std::string numberedPath(const std::string &path, unsigned n)
+{
+	char num[16];
+	size_t dot = path.rfind('.');
+	size_t slash = path.rfind('/');
+
+	snprintf(num, sizeof(num), "_%04u", n);
+	if((dot == std::string::npos) || ((slash != std::string::npos) && (dot < slash)))
+		return path + num;
+	return path.substr(0, dot) + num + path.substr(dot);
+}
+
+int main(int argc, char **argv)
+{
+	std::string device, format, output;
+	unsigned runs = 255;
+	unsigned count = 1;
+	char channel = 'R';
+	bool doInit = false;
+	bool compressed = false;
+	int boardNum = -1;
+	int opt;
+
+	while((opt = getopt(argc, argv, "d:f:n:c:b:ir:zh")) != -1)
+	{
+		switch(opt)
+		{
+			case 'd': device = optarg; break;
+			case 'f': format = optarg; break;
+			case 'n': runs = std::strtoul(optarg, NULL, 0); break;
+			case 'c': channel = optarg[0]; break;
+			case 'b': boardNum = std::strtoul(optarg, NULL, 0); break;
+			case 'i': doInit = true; break;
+			case 'r': count = std::strtoul(optarg, NULL, 0); break;
+			case 'z': compressed = true; break;
+			default: usage(); return 2;
+		}
+	}
+	if((optind != argc - 1) || device.empty() || (runs < 1) || (runs > 255) ||
+		(count < 1) || ((channel != 'L') && (channel != 'R') && (channel != 'B')))
+	{
+		usage();
+		return 2;
+	}
+	output = argv[optind];
+
+	if(format.empty())
+	{
+		size_t dot = output.rfind('.');
+		format = (dot == std::string::npos) ? "wav" : output.substr(dot + 1);
+	}
+	if((format != "wav") && (format != "raw") && (format != "csv"))
+	{
+		std::cerr << "unknown format " << format << "\n";
+		return 2;
+	}
+
+	try
+	{
+		SerialPort port;
+		std::vector<int32_t> left, right;
+		CaptureInfo info;
+		BoardStatus st;
+		std::string path;
+		unsigned n, ms;
+		size_t bytes;
+
+		port.open(device);
+		Board board(port);
+
+		if(doInit)
+		{
+			std::cerr << "Initializing codec...\n";
+			ms = board.init();
+			std::cerr << "Codec ready after " << ms << " ms\n";
+		}
+		board.configure(runs, channel);
+		if(boardNum >= 0)
+			board.selectBoard(boardNum);
+		st = board.status();
+		if(!st.initialized)
+			throw std::runtime_error("board isn't initialized, use -i");
+
+		info.sampleRate = BOARD_SAMPLE_RATE;
+		info.runs = st.runs;
+		info.channel = st.channel;
+		info.board = st.board;
+		info.device = device;
+
+		for(n = 1; n <= count; n++)
+		{
+			ms = board.run(st);
+			if(compressed)
+			{
+				bytes = board.fetchCompressed(left, right);
+			}
+			else
+			{
+				board.fetch(left, right);
+				bytes = left.size() * 8;
+			}
+			info.date = isoDate();
+
+			path = (count > 1) ? numberedPath(output, n) : output;
+			if(format == "wav")
+				writeWav(path, info, left, right);
+			else if(format == "raw")
+				writeRaw(path, info, left, right);
+			else
+				writeCsv(path, info, left, right);
+
+			std::cerr << path << ": " << left.size() << " samples, "
+				<< st.runs << " runs, " << ms << " ms, "
+				<< bytes << " bytes transferred\n";
+		}
+	}
+	catch(const std::exception &e)
+	{
+		std::cerr << "sab_capture: " << e.what() << "\n";
+		return 1;
+	}
+
+	return 0;
+}
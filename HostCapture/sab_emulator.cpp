@@ -0,0 +1,444 @@
+/******************************************************************************
+* SuperAudioBoard host capture tool
+*
+* sab_emulator.cpp
+*
+* Pseudo-terminal stand-in for the board, for testing sab_capture
+* without hardware.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "../SineTestCode/compress.h"
+
+// Stand-in for the board: a pseudo-terminal that answers the sine test's
+// command protocol (see SineTestCode/sine_test.c) with synthetic loopback
+// data, so sab_capture can be tried out without hardware.
+
+#define NUM_SAMP	4080
+#define NUM_RUNS	255
+#define SIG_LENGTH	48
+#define SINE_AMPL	7476354.0	// peak of sine_samples.h
+#define LOOP_GAIN	0.5		// DAC to ADC through the loopback cable
+#define LOOP_DELAY	17		// samples
+#define NOISE_LSB	40
+#define INIT_SETTLE_MS	400		// reported by INIT
+
+static int master = -1;
+static unsigned speedup = 100;
+
+static bool initialized = false;
+static bool dataValid = false;
+static unsigned runs = NUM_RUNS;
+static char channel = 'R';
+static uint8_t regs[9] = { 0, 0x29, 0x80, 0x29, 0x00, 0x00, 0x10, 0x02, 0x00 };
+static std::vector<int32_t> sumRight(NUM_SAMP), sumLeft(NUM_SAMP);
+
+static void send(const void *data, size_t len)
+{
+	const char *p = static_cast<const char *>(data);
+	ssize_t n;
+
+	while(len > 0)
+	{
+		n = write(master, p, len);
+		if(n < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			perror("write");
+			exit(1);
+		}
+		p += n;
+		len -= n;
+	}
+}
+
+static void reply(const std::string &line)
+{
+	std::string s = line + "\r\n";
+
+	send(s.data(), s.size());
+}
+
+static void replyOk(unsigned long val)
+{
+	std::ostringstream s;
+
+	s << "OK " << val;
+	reply(s.str());
+}
+
+// Small noise, roughly uniform.  It restarts with every test, so repeated
+// tests give identical data.
+static uint32_t noiseState;
+
+static int32_t noise(void)
+{
+	uint32_t &state = noiseState;
+
+	state = state * 1664525 + 1013904223;
+	return (int32_t)(state >> 16) % (2 * NOISE_LSB + 1) - NOISE_LSB;
+}
+
+// Linear gain for a DAC channel volume register: mute bit, then the
+// attenuation in dB
+static double dacGain(uint8_t reg)
+{
+	if(reg & 0x80)
+		return 0;
+	return std::pow(10.0, -(reg & 0x7F) / 20.0);
+}
+
+static void runTest(void)
+{
+	unsigned i, r;
+	int32_t out, loop;
+	unsigned long ms;
+	double gainLeft, gainRight;
+
+	// DAC channel A is left, B is right
+	gainLeft = dacGain(regs[4]);
+	gainRight = dacGain(regs[5]);
+
+	noiseState = 12345;
+	for(i = 0; i < NUM_SAMP; i++)
+	{
+		sumRight[i] = 0;
+		sumLeft[i] = 0;
+	}
+
+	// NUM_SAMP is a multiple of SIG_LENGTH, so every run lines up
+	for(r = 0; r < runs; r++)
+	{
+		for(i = 0; i < NUM_SAMP; i++)
+		{
+			out = (int32_t)std::lround(SINE_AMPL *
+				std::sin(2 * M_PI * ((i + SIG_LENGTH - LOOP_DELAY) % SIG_LENGTH) / SIG_LENGTH));
+			loop = (int32_t)(out * LOOP_GAIN * gainRight);
+			sumRight[i] += ((channel != 'L') ? loop : 0) + noise();
+			loop = (int32_t)(out * LOOP_GAIN * gainLeft);
+			sumLeft[i] += ((channel != 'R') ? loop : 0) + noise();
+		}
+	}
+
+	ms = (unsigned long)(runs + 1) * NUM_SAMP * 1000 / 48000;
+	if(speedup)
+		usleep(ms * 1000 / speedup);
+	dataValid = true;
+
+	// Command time, then the time the summed samples span
+	std::ostringstream s;
+	s << "OK " << ms << " " << (unsigned long long)runs * NUM_SAMP * 1000000 / 48000;
+	reply(s.str());
+}
+
+static void sendSums(const std::vector<int32_t> &sums)
+{
+	std::string data;
+	size_t i;
+	uint32_t v;
+
+	for(i = 0; i < sums.size(); i++)
+	{
+		v = (uint32_t)sums[i];
+		data += (char)(v & 0xFF);
+		data += (char)((v >> 8) & 0xFF);
+		data += (char)((v >> 16) & 0xFF);
+		data += (char)(v >> 24);
+	}
+	send(data.data(), data.size());
+}
+
+static void command(const std::string &line)
+{
+	std::istringstream in(line);
+	std::string cmd, arg, extra;
+	unsigned long reg, val;
+	size_t i;
+
+	if(!(in >> cmd))
+	{
+		reply("ERR empty");
+		return;
+	}
+	if(cmd == "STAT")
+	{
+		std::ostringstream s;
+		s << "OK " << initialized << " " << dataValid << " " << runs << " "
+			<< channel << " " << NUM_SAMP << " 0";
+		reply(s.str());
+	}
+	else if(cmd == "PROF")
+	{
+		// Same shape as the board's reply, with nothing measured
+		static const char *stages[] = { "i2s_isr", "usb_isr", "audio_frame", "compress",
+			"usb_tx", "usb_irq_off" };
+		const unsigned num_stages = sizeof(stages) / sizeof(stages[0]);
+		std::string line;
+
+		in >> arg;
+		if(arg == "RESET")
+		{
+			reply("OK");
+			return;
+		}
+		reply("OK " + std::to_string(num_stages) + " 1000");
+		for(i = 0; i < num_stages; i++)
+		{
+			line = stages[i];
+			for(unsigned j = 0; j < 4 + 16; j++)
+				line += " 0";
+			reply(line);
+		}
+	}
+	else if(cmd == "INIT")
+	{
+		// Typical time for the high pass filter to settle
+		if(speedup)
+			usleep(INIT_SETTLE_MS * 1000 / speedup);
+		// Zero cross soft ramp, like codec_init()
+		regs[3] = 0x39;
+		initialized = true;
+		reply("OK " + std::to_string(INIT_SETTLE_MS));
+	}
+	else if(cmd == "CFG")
+	{
+		in >> arg;
+		if(arg == "RUNS")
+		{
+			if(!(in >> val) || (val < 1) || (val > NUM_RUNS))
+			{
+				reply("ERR bad value");
+				return;
+			}
+			runs = val;
+		}
+		else if(arg == "CH")
+		{
+			in >> extra;
+			if((extra != "L") && (extra != "R") && (extra != "B"))
+			{
+				reply("ERR bad value");
+				return;
+			}
+			channel = extra[0];
+		}
+		else if(arg == "BOARD")
+		{
+			// Only the one board here
+			if(!(in >> val) || (val != 0))
+			{
+				reply("ERR bad value");
+				return;
+			}
+		}
+		else
+		{
+			reply("ERR bad setting");
+			return;
+		}
+		dataValid = false;
+		reply("OK");
+	}
+	else if(!initialized)
+	{
+		reply("ERR not initialized");
+	}
+	else if(cmd == "RUN")
+	{
+		runTest();
+	}
+	else if(cmd == "GET")
+	{
+		if(!dataValid)
+		{
+			reply("ERR no data");
+		}
+		else if(!(in >> arg))
+		{
+			replyOk(2 * NUM_SAMP * sizeof(int32_t));
+			sendSums(sumRight);
+			sendSums(sumLeft);
+		}
+		else if(arg == "RICE")
+		{
+			// Same encoder and block size as the firmware
+			std::vector<uint8_t> frame(COMPRESS_FRAME_MAX(COMPRESS_BLOCK_LEN));
+			unsigned len, n;
+
+			replyOk(NUM_SAMP);
+			for(i = 0; i < NUM_SAMP; i += n)
+			{
+				n = ((NUM_SAMP - i) < COMPRESS_BLOCK_LEN) ? (NUM_SAMP - i) : COMPRESS_BLOCK_LEN;
+				len = compress_frame(&sumRight[i], &sumLeft[i], n, frame.data());
+				send(frame.data(), len);
+			}
+			len = compress_end(frame.data());
+			send(frame.data(), len);
+		}
+		else if(arg == "CSV")
+		{
+			std::ostringstream s;
+			replyOk(NUM_SAMP);
+			for(i = 0; i < NUM_SAMP; i++)
+				s << sumRight[i] << "," << sumLeft[i] << "\r\n";
+			send(s.str().data(), s.str().size());
+		}
+		else
+		{
+			reply("ERR bad format");
+		}
+	}
+	else if(cmd == "RR")
+	{
+		if(!(in >> std::setbase(0) >> reg) || (reg < 1) || (reg > 8))
+			reply("ERR bad register");
+		else
+			replyOk(regs[reg]);
+	}
+	else if(cmd == "RD")
+	{
+		std::ostringstream s;
+		s << "OK";
+		for(i = 1; i <= 8; i++)
+			s << " " << (unsigned)regs[i];
+		reply(s.str());
+	}
+	else if(cmd == "VOL")
+	{
+		unsigned left, right;
+
+		if(!(in >> std::setbase(0) >> left >> right) || (left > 127) || (right > 127))
+			reply("ERR bad value");
+		else
+		{
+			regs[4] = (regs[4] & 0x80) | left;
+			regs[5] = (regs[5] & 0x80) | right;
+			reply("OK");
+		}
+	}
+	else if(cmd == "MUTE")
+	{
+		if(!(in >> std::setbase(0) >> val) || (val > 1))
+			reply("ERR bad value");
+		else
+		{
+			regs[4] = (regs[4] & 0x7F) | (val ? 0x80 : 0);
+			regs[5] = (regs[5] & 0x7F) | (val ? 0x80 : 0);
+			reply("OK");
+		}
+	}
+	else if(cmd == "RW")
+	{
+		if(!(in >> std::setbase(0) >> reg) || (reg < 1) || (reg >= 8))
+			reply("ERR bad register");
+		else if(!(in >> std::setbase(0) >> val) || (val > 0xFF))
+			reply("ERR bad value");
+		else
+		{
+			regs[reg] = val;
+			reply("OK");
+		}
+	}
+	else
+	{
+		reply("ERR unknown command");
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct termios tio;
+	std::string line;
+	char buf[256];
+	ssize_t n, i;
+	int slave, opt;
+
+	while((opt = getopt(argc, argv, "s:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 's': speedup = std::strtoul(optarg, NULL, 0); break;
+			default:
+				std::cerr << "usage: sab_emulator [-s speedup]\n"
+					"  Test and INIT times are divided by speedup (default 100,\n"
+					"  0 for no waiting).  The pty to use is printed on stdout.\n";
+				return 2;
+		}
+	}
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if((master < 0) || grantpt(master) || unlockpt(master))
+	{
+		perror("posix_openpt");
+		return 1;
+	}
+
+	// Hold the slave side open in raw mode, so replies aren't echoed back
+	// and the pty survives sab_capture closing it
+	slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+	if((slave < 0) || tcgetattr(slave, &tio))
+	{
+		perror(ptsname(master));
+		return 1;
+	}
+	cfmakeraw(&tio);
+	tcsetattr(slave, TCSANOW, &tio);
+
+	std::cout << ptsname(master) << std::endl;
+
+	while((n = read(master, buf, sizeof(buf))) > 0)
+	{
+		for(i = 0; i < n; i++)
+		{
+			if((buf[i] == '\r') || (buf[i] == '\n'))
+			{
+				// Like the board, ignore the empty line between "\r\n"
+				if(!line.empty())
+					command(line);
+				line.clear();
+			}
+			else
+			{
+				line += buf[i];
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,190 @@
+/******************************************************************************
+* SuperAudioBoard host capture tool
+*
+* serial_port.cpp
+*
+* Raw serial port access for talking to the board.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#include "serial_port.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+static std::runtime_error sysError(const std::string &what)
+{
+	return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+SerialPort::SerialPort() : fd(-1)
+{
+}
+
+SerialPort::~SerialPort()
+{
+	close();
+}
+
+void SerialPort::open(const std::string &path)
+{
+	struct termios tio;
+
+	close();
+
+	fd = ::open(path.c_str(), O_RDWR | O_NOCTTY);
+	if(fd < 0)
+		throw sysError("can't open " + path);
+
+	// The baud rate is ignored by CDC ACM, but the line discipline has to
+	// be turned off completely or binary data gets mangled
+	if(tcgetattr(fd, &tio) == 0)
+	{
+		cfmakeraw(&tio);
+		tio.c_cc[VMIN] = 1;
+		tio.c_cc[VTIME] = 0;
+		cfsetspeed(&tio, B115200);
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+	tcflush(fd, TCIOFLUSH);
+
+	devPath = path;
+	pending.clear();
+}
+
+void SerialPort::close()
+{
+	if(fd >= 0)
+		::close(fd);
+	fd = -1;
+}
+
+void SerialPort::write(const void *data, size_t len)
+{
+	const char *p = static_cast<const char *>(data);
+	ssize_t n;
+
+	while(len > 0)
+	{
+		n = ::write(fd, p, len);
+		if(n < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			throw sysError("write to " + devPath);
+		}
+		p += n;
+		len -= n;
+	}
+}
+
+void SerialPort::writeLine(const std::string &line)
+{
+	write((line + "\r\n").data(), line.size() + 2);
+}
+
+size_t SerialPort::read(void *data, size_t len, int timeoutMs)
+{
+	size_t n;
+
+	// Leftovers from readLine() go first
+	if(!pending.empty())
+	{
+		n = (pending.size() < len) ? pending.size() : len;
+		std::memcpy(data, pending.data(), n);
+		pending.erase(0, n);
+		return n;
+	}
+
+	return readPort(data, len, timeoutMs);
+}
+
+size_t SerialPort::readPort(void *data, size_t len, int timeoutMs)
+{
+	struct pollfd pfd;
+	ssize_t n;
+	int ret;
+
+	if(len == 0)
+		return 0;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	do
+	{
+		ret = poll(&pfd, 1, timeoutMs);
+	} while((ret < 0) && (errno == EINTR));
+	if(ret < 0)
+		throw sysError("poll on " + devPath);
+	if(ret == 0)
+		return 0;
+
+	n = ::read(fd, data, len);
+	if(n < 0)
+		throw sysError("read from " + devPath);
+	if(n == 0)
+		throw std::runtime_error(devPath + " closed");
+	return n;
+}
+
+std::string SerialPort::readLine(int timeoutMs)
+{
+	char buf[256];
+	size_t pos, n;
+	std::string line;
+
+	while((pos = pending.find('\n')) == std::string::npos)
+	{
+		n = readPort(buf, sizeof(buf), timeoutMs);
+		if(n == 0)
+			throw std::runtime_error("timeout waiting for a reply from " + devPath);
+		pending.append(buf, n);
+	}
+
+	line = pending.substr(0, pos);
+	pending.erase(0, pos + 1);
+	if(!line.empty() && (line[line.size() - 1] == '\r'))
+		line.erase(line.size() - 1);
+
+	return line;
+}
+
+void SerialPort::readExact(void *data, size_t len, int timeoutMs)
+{
+	char *p = static_cast<char *>(data);
+	size_t n;
+
+	while(len > 0)
+	{
+		n = read(p, len, timeoutMs);
+		if(n == 0)
+			throw std::runtime_error("timeout reading data from " + devPath);
+		p += n;
+		len -= n;
+	}
+}
@@ -0,0 +1,74 @@
+/******************************************************************************
+* SuperAudioBoard host capture tool
+*
+* serial_port.h
+*
+* Raw serial port access for talking to the board.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#ifndef SERIAL_PORT_H
+#define SERIAL_PORT_H
+
+#include <cstddef>
+#include <string>
+
+// Raw (no line discipline) access to the board's CDC serial port, or to a
+// pseudo-terminal standing in for it.  Errors and timeouts are reported
+// by throwing std::runtime_error.
+class SerialPort
+{
+public:
+	SerialPort();
+	~SerialPort();
+
+	void open(const std::string &path);
+	void close();
+	const std::string &path() const { return devPath; }
+
+	void write(const void *data, size_t len);
+	void writeLine(const std::string &line);
+
+	// Read up to len bytes, waiting at most timeoutMs for the first one.
+	// Returns the number of bytes read, 0 on timeout.
+	size_t read(void *data, size_t len, int timeoutMs);
+
+	// Read one line, without the "\r\n"
+	std::string readLine(int timeoutMs);
+
+	// Read exactly len bytes
+	void readExact(void *data, size_t len, int timeoutMs);
+
+	SerialPort(const SerialPort &) = delete;
+	SerialPort &operator=(const SerialPort &) = delete;
+
+private:
+	size_t readPort(void *data, size_t len, int timeoutMs);
+
+	int fd;
+	std::string devPath;
+
+	// Bytes that came in after the end of the last line
+	std::string pending;
+};
+
+#endif
@@ -0,0 +1,249 @@
+/******************************************************************************
+* SuperAudioBoard host capture tool
+*
+* usb_audio_sim.c
+*
+* Runs the firmware's USB audio buffering (SineTestCode/usb_audio.c) on
+* the PC against a simulated host, and checks the FIFO levels and the
+* rate feedback.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+// Built with USB_SERIAL_AUDIO defined (see the Makefile).  The firmware
+// file is included rather than linked so the checks can see its FIFOs.
+#include "../SineTestCode/usb_audio.c"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Simulated run, and how long the FIFOs get to settle before checking
+#define SIM_SECONDS     30
+#define SETTLE_SECONDS  5
+
+// How far the FIFO levels may stray from where they're steered to, half a
+// packet (the record side's dead band) plus a little jitter
+#define PLAY_TOLERANCE  (FRAMES_PER_PACKET / 2 + 2)
+#define REC_TOLERANCE   (FRAMES_PER_PACKET / 2 + 2)
+
+// Codec clock errors to try, in ppm of 48kHz
+static const int ppm_cases[] = { 0, 100, -100, 500, -500, 2000, -2000 };
+
+// Frames dropped so far, counted by either interrupt
+#define UNDERRUNS() (usb_audio_tx_underruns + usb_audio_play_underruns)
+#define OVERRUNS()  (usb_audio_rx_overruns + usb_audio_rec_overruns)
+
+// Sample n of a test stream, 24 bits left justified like the I2S data
+#define TEST_SAMPLE(n, ch) ((int32_t)((((uint32_t)(n) * 2 + (ch)) & 0xFFFFFF) << 8))
+
+// Put the firmware back to how it starts up
+static void reset_state(void)
+{
+	memset(&play_fifo, 0, sizeof(play_fifo));
+	memset(&rec_fifo, 0, sizeof(rec_fifo));
+	play_primed = 0;
+	rec_primed = 0;
+	i2s_frame_count = 0;
+	feedback_start_count = 0;
+	feedback_sof_count = 0;
+	feedback_value = FEEDBACK_NOMINAL;
+	usb_audio_rx_overruns = 0;
+	usb_audio_tx_underruns = 0;
+	usb_audio_play_underruns = 0;
+	usb_audio_rec_overruns = 0;
+	usb_audio_receive_setting = 1;
+	usb_audio_transmit_setting = 1;
+}
+
+// One run at a codec clock ppm away from nominal.  Returns the number of
+// failed checks.
+static int run_case(int ppm)
+{
+	// Time in ps: the host's 1 ms frames, and the codec's sample clock
+	const double sof_period = 1e9;
+	const double i2s_period = 1e12 / (AUDIO_SAMPLE_RATE * (1.0 + ppm * 1e-6));
+	double next_sof = 0.0, next_i2s = 0.0;
+
+	uint8_t packet[AUDIO_RX_SIZE > AUDIO_TX_SIZE ? AUDIO_RX_SIZE : AUDIO_TX_SIZE];
+	uint8_t sync[4];
+	uint32_t fb_acc = 0, fb, frames, len, i, ms = 0;
+	uint32_t host_out = 0, host_in = 0, dev_out = 0, dev_in = 0;
+	uint32_t play_started = 0, bad_play = 0, bad_rec = 0;
+	uint32_t underruns = 0, overruns = 0;
+	int32_t left, right, play_min = 0x7FFFFFFF, play_max = 0;
+	int32_t rec_min = 0x7FFFFFFF, rec_max = 0, level;
+	double fb_sum = 0.0, expected, fb_mean;
+	uint32_t fb_num = 0;
+	int failed = 0;
+
+	reset_state();
+
+	while(ms < SIM_SECONDS * 1000)
+	{
+		if(next_i2s < next_sof)
+		{
+			// I2S interrupt: record a test sample, play whatever comes out
+			usb_audio_i2s_frame(TEST_SAMPLE(dev_in, 0), TEST_SAMPLE(dev_in, 1),
+					&left, &right);
+			dev_in++;
+
+			if(left || right || play_started)
+			{
+				if(!play_started)
+				{
+					play_started = 1;
+					dev_out = (uint32_t)left >> 9;
+				}
+				if((left != TEST_SAMPLE(dev_out, 0)) || (right != TEST_SAMPLE(dev_out, 1)))
+					bad_play++;
+				dev_out++;
+			}
+			next_i2s += i2s_period;
+			continue;
+		}
+
+		// USB frame: start of frame, then the host reads the feedback,
+		// sends the OUT packet it asks for and takes an IN packet.  The
+		// levels are checked at the start of frame, which is where the
+		// firmware measures the play level too.
+		usb_audio_sof();
+
+		if(ms >= SETTLE_SECONDS * 1000)
+		{
+			level = (uint16_t)(play_fifo.head - play_fifo.tail);
+			if(level < play_min)
+				play_min = level;
+			if(level > play_max)
+				play_max = level;
+			level = (uint16_t)(rec_fifo.head - rec_fifo.tail);
+			if(level < rec_min)
+				rec_min = level;
+			if(level > rec_max)
+				rec_max = level;
+		}
+
+		usb_audio_sync_callback(sync);
+		fb = sync[0] | (sync[1] << 8) | (sync[2] << 16);
+		if((fb < FEEDBACK_MIN) || (fb > FEEDBACK_MAX))
+		{
+			printf("  feedback %u out of range\n", fb);
+			failed++;
+		}
+		fb_acc += fb;
+		frames = fb_acc >> 14;
+		fb_acc &= 0x3FFF;
+		if(frames * AUDIO_FRAME_BYTES > AUDIO_RX_SIZE)
+		{
+			printf("  feedback %u asks for more than a packet\n", fb);
+			failed++;
+			frames = AUDIO_RX_SIZE / AUDIO_FRAME_BYTES;
+		}
+		for(i = 0; i < frames; i++)
+		{
+			pack24(packet + i * AUDIO_FRAME_BYTES, TEST_SAMPLE(host_out, 0));
+			pack24(packet + i * AUDIO_FRAME_BYTES + 3, TEST_SAMPLE(host_out, 1));
+			host_out++;
+		}
+		usb_audio_receive_callback(packet, frames * AUDIO_FRAME_BYTES);
+
+		len = usb_audio_transmit_callback(packet);
+		if(len > AUDIO_TX_SIZE)
+		{
+			printf("  IN packet of %u bytes\n", len);
+			failed++;
+		}
+		for(i = 0; i < len; i += AUDIO_FRAME_BYTES)
+		{
+			if((unpack24(packet + i) != TEST_SAMPLE(host_in, 0))
+					|| (unpack24(packet + i + 3) != TEST_SAMPLE(host_in, 1)))
+				bad_rec++;
+			host_in++;
+		}
+
+		ms++;
+		next_sof += sof_period;
+
+		if(ms == SETTLE_SECONDS * 1000)
+		{
+			underruns = UNDERRUNS();
+			overruns = OVERRUNS();
+		}
+		if(ms > SETTLE_SECONDS * 1000)
+		{
+			fb_sum += fb;
+			fb_num++;
+		}
+	}
+
+	// The host's average rate has to end up matching the codec's exactly,
+	// otherwise the play FIFO would be drifting
+	expected = AUDIO_SAMPLE_RATE * (1.0 + ppm * 1e-6) / 1000.0;
+	fb_mean = fb_sum / fb_num / 16384.0;
+
+	printf("%+5d ppm: feedback %.4f frames/ms (codec %.4f), play FIFO %d-%d, "
+			"record FIFO %d-%d\n", ppm, fb_mean, expected, play_min, play_max,
+			rec_min, rec_max);
+
+	if(fabs(fb_mean - expected) > 0.001)
+	{
+		printf("  feedback doesn't match the codec rate\n");
+		failed++;
+	}
+	if((play_min < USB_AUDIO_FIFO_FRAMES / 2 - PLAY_TOLERANCE)
+			|| (play_max > USB_AUDIO_FIFO_FRAMES / 2 + PLAY_TOLERANCE))
+	{
+		printf("  play FIFO not held near half full\n");
+		failed++;
+	}
+	if((rec_min < REC_TARGET - REC_TOLERANCE) || (rec_max > REC_TARGET + REC_TOLERANCE))
+	{
+		printf("  record FIFO not held near %d frames\n", REC_TARGET);
+		failed++;
+	}
+	if((UNDERRUNS() != underruns) || (OVERRUNS() != overruns))
+	{
+		printf("  %u underruns, %u overruns after settling\n",
+				UNDERRUNS() - underruns, OVERRUNS() - overruns);
+		failed++;
+	}
+	if(!play_started || bad_play || bad_rec)
+	{
+		printf("  samples lost or out of order (%u played, %u recorded)\n",
+				bad_play, bad_rec);
+		failed++;
+	}
+
+	return failed;
+}
+
+int main(void)
+{
+	unsigned i;
+	int failed = 0;
+
+	for(i = 0; i < sizeof(ppm_cases) / sizeof(ppm_cases[0]); i++)
+		failed += run_case(ppm_cases[i]);
+
+	printf("%s\n", failed ? "FAILED" : "OK");
+	return failed ? 1 : 0;
+}
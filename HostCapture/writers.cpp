@@ -0,0 +1,181 @@
+/******************************************************************************
+* SuperAudioBoard host capture tool
+*
+* writers.cpp
+*
+* WAV, raw and CSV output with capture metadata.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#include "writers.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+static std::string infoText(const CaptureInfo &info, size_t samples, const char *sep)
+{
+	std::ostringstream s;
+
+	s << "device=" << info.device << sep
+		<< "date=" << info.date << sep
+		<< "sample_rate=" << info.sampleRate << sep
+		<< "samples=" << samples << sep
+		<< "runs=" << info.runs << sep
+		<< "sine_channel=" << info.channel << sep
+		<< "board=" << info.board;
+	return s.str();
+}
+
+static void openOut(std::ofstream &out, const std::string &path)
+{
+	out.open(path.c_str(), std::ios::binary | std::ios::trunc);
+	if(!out)
+		throw std::runtime_error("can't create " + path);
+}
+
+static void closeOut(std::ofstream &out, const std::string &path)
+{
+	out.close();
+	if(!out)
+		throw std::runtime_error("error writing " + path);
+}
+
+static void put16(std::string &s, uint32_t v)
+{
+	s += (char)(v & 0xFF);
+	s += (char)((v >> 8) & 0xFF);
+}
+
+static void put32(std::string &s, uint32_t v)
+{
+	put16(s, v & 0xFFFF);
+	put16(s, v >> 16);
+}
+
+// Average of a sum of runs, rounded and clipped to 24 bits
+static int32_t average24(int32_t sum, unsigned runs)
+{
+	int64_t v = (int64_t)sum;
+	int64_t half = runs / 2;
+
+	v = (v >= 0) ? (v + half) / (int64_t)runs : -((-v + half) / (int64_t)runs);
+	if(v > 8388607)
+		v = 8388607;
+	if(v < -8388608)
+		v = -8388608;
+	return (int32_t)v;
+}
+
+void writeWav(const std::string &path, const CaptureInfo &info,
+	const std::vector<int32_t> &left, const std::vector<int32_t> &right)
+{
+	std::ofstream out;
+	std::string comment, list, hdr, data;
+	size_t i;
+	unsigned runs = info.runs ? info.runs : 1;
+
+	data.reserve(left.size() * 6);
+	for(i = 0; i < left.size(); i++)
+	{
+		int32_t l = average24(left[i], runs);
+		int32_t r = average24(right[i], runs);
+		data += (char)(l & 0xFF);
+		data += (char)((l >> 8) & 0xFF);
+		data += (char)((l >> 16) & 0xFF);
+		data += (char)(r & 0xFF);
+		data += (char)((r >> 8) & 0xFF);
+		data += (char)((r >> 16) & 0xFF);
+	}
+	if(data.size() & 1)
+		data += '\0';
+
+	// INFO strings are null terminated and chunks are padded to even length
+	comment = infoText(info, left.size(), " ");
+	comment += '\0';
+	if(comment.size() & 1)
+		comment += '\0';
+	list = "INFO";
+	list += "ICMT";
+	put32(list, comment.size());
+	list += comment;
+
+	hdr = "RIFF";
+	put32(hdr, 4 + (8 + 16) + (8 + list.size()) + (8 + left.size() * 6));
+	hdr += "WAVE";
+	hdr += "fmt ";
+	put32(hdr, 16);
+	put16(hdr, 1);				// PCM
+	put16(hdr, 2);				// channels
+	put32(hdr, info.sampleRate);
+	put32(hdr, info.sampleRate * 6);	// bytes per second
+	put16(hdr, 6);				// block align
+	put16(hdr, 24);				// bits per sample
+	hdr += "LIST";
+	put32(hdr, list.size());
+	hdr += list;
+	hdr += "data";
+	put32(hdr, left.size() * 6);
+
+	openOut(out, path);
+	out.write(hdr.data(), hdr.size());
+	out.write(data.data(), data.size());
+	closeOut(out, path);
+}
+
+void writeRaw(const std::string &path, const CaptureInfo &info,
+	const std::vector<int32_t> &left, const std::vector<int32_t> &right)
+{
+	std::ofstream out;
+	std::string data;
+	size_t i;
+
+	data.reserve(left.size() * 8);
+	for(i = 0; i < left.size(); i++)
+	{
+		put32(data, (uint32_t)left[i]);
+		put32(data, (uint32_t)right[i]);
+	}
+	openOut(out, path);
+	out.write(data.data(), data.size());
+	closeOut(out, path);
+
+	openOut(out, path + ".txt");
+	out << "format=s32le" << "\n"
+		<< "channels=left,right" << "\n"
+		<< infoText(info, left.size(), "\n") << "\n";
+	closeOut(out, path + ".txt");
+}
+
+void writeCsv(const std::string &path, const CaptureInfo &info,
+	const std::vector<int32_t> &left, const std::vector<int32_t> &right)
+{
+	std::ofstream out;
+	size_t i;
+
+	openOut(out, path);
+	out << "# " << infoText(info, left.size(), "\n# ") << "\n";
+	out << "left,right\n";
+	for(i = 0; i < left.size(); i++)
+		out << left[i] << "," << right[i] << "\n";
+	closeOut(out, path);
+}
@@ -0,0 +1,62 @@
+/******************************************************************************
+* SuperAudioBoard host capture tool
+*
+* writers.h
+*
+* WAV, raw and CSV output with capture metadata.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#ifndef WRITERS_H
+#define WRITERS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Description of a capture, written into every output file
+struct CaptureInfo
+{
+	unsigned sampleRate;
+	unsigned runs;		// each value is the sum of this many runs
+	char channel;		// channel the sine was played on
+	unsigned board;		// board the data came from
+	std::string device;
+	std::string date;	// ISO 8601
+};
+
+// 24 bit stereo WAV of the averaged samples, with the capture info in a
+// LIST/INFO comment
+void writeWav(const std::string &path, const CaptureInfo &info,
+	const std::vector<int32_t> &left, const std::vector<int32_t> &right);
+
+// Interleaved little endian int32 sums (left, right), plus the capture
+// info in <path>.txt
+void writeRaw(const std::string &path, const CaptureInfo &info,
+	const std::vector<int32_t> &left, const std::vector<int32_t> &right);
+
+// "left,right" sums, one line per sample, after '#' comment lines with the
+// capture info
+void writeCsv(const std::string &path, const CaptureInfo &info,
+	const std::vector<int32_t> &left, const std::vector<int32_t> &right);
+
+#endif
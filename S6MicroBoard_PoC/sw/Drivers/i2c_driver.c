@@ -36,6 +36,20 @@ int I2C_SetDivideRatio(XIOModule *inst, u8 ratio)
 	return 0;
 }
 
+/* Set divide ratio for an SCL rate */
+u32 I2C_SetClock(XIOModule *inst, u32 freq)
+{
+	u32 ratio = (I2C_MODULE_CLK_HZ + 4 * freq - 1) / (4 * freq);
+
+	if(ratio > 0)
+		ratio--;
+	if(ratio > 255)
+		ratio = 255;
+
+	I2C_SetDivideRatio(inst, (u8)ratio);
+	return I2C_MODULE_CLK_HZ / (4 * (ratio + 1));
+}
+
 /* Enable I2C interface */
 int I2C_EnableInterface(XIOModule *inst)
 {
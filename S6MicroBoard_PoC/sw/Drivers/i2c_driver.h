@@ -69,9 +69,25 @@
  * Functions
  ******************************************************************************/
 
+/* Clock driving the I2C module (the MicroBlaze clock) */
+#ifndef I2C_MODULE_CLK_HZ
+#define I2C_MODULE_CLK_HZ	100000000u
+#endif
+
+/* Standard, fast mode and fast mode plus SCL rates */
+#define I2C_CLOCK_100K		100000u
+#define I2C_CLOCK_400K		400000u
+#define I2C_CLOCK_1M		1000000u
+
 /* Set module divide ratio */
 int I2C_SetDivideRatio(XIOModule *inst, u8 ratio);
 
+/* Set the divide ratio for the fastest SCL rate that isn't over freq,
+ * returns the actual rate in Hz.  The divider strobes four times per SCL
+ * period, so SCL = I2C_MODULE_CLK_HZ / (4 * (ratio + 1)), and the slowest
+ * rate is about 98kHz at 100MHz. */
+u32 I2C_SetClock(XIOModule *inst, u32 freq);
+
 /* Enable I2C interface */
 int I2C_EnableInterface(XIOModule *inst);
 
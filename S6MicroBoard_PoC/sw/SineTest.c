@@ -28,6 +28,8 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "platform.h"
 #include "cs4272.h"
 #include "delay.h"
@@ -38,6 +40,18 @@
 
 #define SERIAL_INPUT_BUFFER_LEN 32
 
+// Wait for the codec's ADC high pass filter to take out the DC offset by
+// averaging blocks of SETTLE_BLOCK_LEN frames; it's settled once the
+// block averages on both channels move by no more than SETTLE_DC_STEP
+// for SETTLE_BLOCKS blocks in a row.  SETTLE_MAX_FRAMES is the old fixed
+// 5 second wait at 48kHz.
+#define SETTLE_BLOCK_SHIFT 10
+#define SETTLE_BLOCK_LEN (1 << SETTLE_BLOCK_SHIFT)
+#define SETTLE_BLOCKS 4
+#define SETTLE_DC_STEP 32
+#define SAMPLE_RATE 48000
+#define SETTLE_MAX_FRAMES (5 * SAMPLE_RATE)
+
 int32_t input_buffer[MAX_INPUT_LEN];
 
 char serialInputBuffer[SERIAL_INPUT_BUFFER_LEN];
@@ -52,6 +66,8 @@ u8 serial_read_line(char* buf, u8 max_len);
 
 void clearInpBuffer(void);
 
+u32 WaitForSettle(void);
+
 typedef enum
 {
 	Left,
@@ -62,6 +78,8 @@ Channel selectedChannel;
 
 void RunSineTest(void);
 
+void ProcessCommand(char *cmd);
+
 int main()
 {
     init_platform();
@@ -72,65 +90,71 @@ int main()
 
     codec_init(&iomod_inst);
 
-    wait_ms(&iomod_inst,1000);
-    print("Codec Initialized\r\n");
-    print("Reading back registers\r\n");
-
-    int i;
-    uint8_t regData;
-    for(i = 1; i < 9; i++)
-    {
-    	regData = codec_read(&iomod_inst,i);
-    	print("Address ");
-    	print_u32_hex((u32)i);
-    	print(" ");
-    	print_u32_hex((u32)regData);
-    	print("\r\n");
-    }
-
-    print("Waiting 5 seconds for codec HPF to stabilize...\r\n");
-
-    wait_ms(&iomod_inst,5000);
+    print("Waiting for codec HPF to stabilize...\r\n");
+    xil_printf("Ready after %d ms\r\n", WaitForSettle());
 
     u8 numCharsRet;
 
-    clearInpBuffer();
+    // Command loop, one command per line and one reply per command so a
+    // host script can run tests back to back:
+    //
+    // RUN L / RUN R   Run the sine test on the left or right channel,
+    //                 reply "OK <n>" followed by n sample lines
+    // RR <reg>        Read a codec register, reply "OK <hex value>"
+    //
+    // Anything else gets "ERR <reason>"
+    print("READY\r\n");
 
     while(1)
     {
-    	print("Please select the channel (L/R)\r\n> ");
-    	numCharsRet = serial_read_line(serialInputBuffer,SERIAL_INPUT_BUFFER_LEN);
+    	clearInpBuffer();
+    	numCharsRet = serial_read_line(serialInputBuffer,SERIAL_INPUT_BUFFER_LEN - 1);
 
-    	if(numCharsRet > 0)
-    	{
-    		if((serialInputBuffer[0] == 'l') || (serialInputBuffer[0] == 'L'))
-    		{
-    			selectedChannel = Left;
-    			break;
-    		}
-    		else if((serialInputBuffer[0] == 'r') || (serialInputBuffer[0] == 'R'))
-    		{
-    			selectedChannel = Right;
-    			break;
-    		}
-    	}
+    	// Drop the '\r' of a "\r\n" line ending
+    	if((numCharsRet > 0) && (serialInputBuffer[numCharsRet - 1] == '\r'))
+    		numCharsRet--;
+    	serialInputBuffer[numCharsRet] = '\0';
 
-    	print("Invalid channel selection.\r\n");
+    	if(numCharsRet > 0)
+    		ProcessCommand(serialInputBuffer);
     }
-    clearInpBuffer();
 
-    RunSineTest();
+    return 0;
+}
 
+void ProcessCommand(char *cmd)
+{
+    int i;
+    int reg;
 
-    for(i = 0; i < MAX_INPUT_LEN; i++)
+    if((strcmp(cmd, "RUN L") == 0) || (strcmp(cmd, "RUN R") == 0))
     {
-    	xil_printf("%d\r\n",input_buffer[i]);
-    }
+    	selectedChannel = (cmd[4] == 'L') ? Left : Right;
 
-    print("End of samples\r\n");
+    	RunSineTest();
 
-
-    return 0;
+    	xil_printf("OK %d\r\n", MAX_INPUT_LEN);
+    	for(i = 0; i < MAX_INPUT_LEN; i++)
+    	{
+    		xil_printf("%d\r\n",input_buffer[i]);
+    	}
+    }
+    else if(strncmp(cmd, "RR ", 3) == 0)
+    {
+    	reg = atoi(cmd + 3);
+    	if((reg < 1) || (reg > 8))
+    	{
+    		print("ERR bad register\r\n");
+    		return;
+    	}
+    	print("OK ");
+    	print_u32_hex((u32)codec_read(&iomod_inst,reg));
+    	print("\r\n");
+    }
+    else
+    {
+    	print("ERR unknown command\r\n");
+    }
 }
 
 void print_u32_hex(u32 val)
@@ -191,10 +215,53 @@ void clearInpBuffer(void)
 	}
 }
 
-void RunSineTest(void)
+// Watch the ADC data until the high pass filter has settled, with the
+// outputs at zero.  Frames only arrive once the codec is running, so this
+// also covers waiting for it to power up.  Returns the time it took in
+// ms, counted in frames.
+u32 WaitForSettle(void)
 {
+    int64_t sumLeft = 0, sumRight = 0;
+    int32_t meanLeft, meanRight;
+    int32_t prevLeft = 0, prevRight = 0;
+    u32 frames = 0;
+    u8 count = 0;
+
+    while((count < SETTLE_BLOCKS) && (frames < SETTLE_MAX_FRAMES))
+    {
+        waitForI2SData(&iomod_inst);
+
+        XIOModule_IoWriteWord(&iomod_inst,I2S_TX_L,0);
+        XIOModule_IoWriteWord(&iomod_inst,I2S_TX_R,0);
+        sumLeft += ((int32_t)XIOModule_IoReadWord(&iomod_inst,I2S_RX_L)) >> 8;
+        sumRight += ((int32_t)XIOModule_IoReadWord(&iomod_inst,I2S_RX_R)) >> 8;
+        frames++;
+
+        if(frames & (SETTLE_BLOCK_LEN - 1))
+            continue;
+
+        meanLeft = sumLeft >> SETTLE_BLOCK_SHIFT;
+        meanRight = sumRight >> SETTLE_BLOCK_SHIFT;
+        sumLeft = 0;
+        sumRight = 0;
+
+        // Nothing to compare the first block against
+        if((frames > SETTLE_BLOCK_LEN)
+                && (abs(meanLeft - prevLeft) <= SETTLE_DC_STEP)
+                && (abs(meanRight - prevRight) <= SETTLE_DC_STEP))
+            count++;
+        else
+            count = 0;
 
-    print("Starting Sine test...\r\n");
+        prevLeft = meanLeft;
+        prevRight = meanRight;
+    }
+
+    return frames / (SAMPLE_RATE / 1000);
+}
+
+void RunSineTest(void)
+{
 
     // Zero out input array
     int i;
@@ -251,8 +318,6 @@ void RunSineTest(void)
     	}
 
     }
-
-    print("Test finished, printing samples.\r\n");
 }
 
 
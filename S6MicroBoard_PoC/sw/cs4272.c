@@ -171,7 +171,8 @@ void codec_init(XIOModule *inst)
 	// Setup Initial Codec
 	
 	// Initialize I2C
-	I2C_SetDivideRatio(inst,250u);
+	// The CS4272 control port is only rated for 100kHz
+	I2C_SetClock(inst,I2C_CLOCK_100K);
 	wait_ms(inst, 1);
 	I2C_EnableInterface(inst);
 	wait_ms(inst, 100);
@@ -202,11 +203,12 @@ void codec_init(XIOModule *inst)
 	// Set ratio select for MCLK=512*LRCLK (BCLK = 64*LRCLK), and master mode
 	codec_write(inst, CODEC_MODE_CONTROL, CODEC_MC_RATIO_SEL(2) | CODEC_MC_MASTER_SLAVE);
 
-	wait_ms(inst, 10);
+	// Register writes take effect at the end of each byte, so there's no
+	// need to wait before powering up
 	
 	// Release power down bit to start up codec
 	codec_write(inst, CODEC_MODE_CTRL2, CODEC_MODE_CTRL2_CTRL_PORT_EN);
-	
-	// Wait for everything to come up
-	wait_ms(inst, 10);
+
+	// No fixed wait for the codec to power up here, it starts sending
+	// I2S frames once it's running and the caller waits for those
 }
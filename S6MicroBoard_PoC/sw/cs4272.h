@@ -50,33 +50,33 @@ void codec_init(XIOModule *inst);
 #define CODEC_DAC_CONTROL							(uint8_t)0x02
 #define CODEC_DAC_CTRL_AUTO_MUTE					(uint8_t)0x80
 #define CODEC_DAC_CTRL_FILTER_SEL					(uint8_t)0x40
-#define CODEC_DAC_CTRL_DE_EMPHASIS					(uint8_t)(((x) & 0x03) << 4)
+#define CODEC_DAC_CTRL_DE_EMPHASIS(x)				(uint8_t)(((x) & 0x03) << 4)
 #define CODEC_DAC_CTRL_VOL_RAMP_UP					(uint8_t)0x08
 #define CODEC_DAC_CTRL_VOL_RAMP_DN					(uint8_t)0x04
-#define CODEC_DAC_CTRL_INV_POL						(uint8_t)(((x) & 0x03) << 0)
+#define CODEC_DAC_CTRL_INV_POL(x)					(uint8_t)(((x) & 0x03) << 0)
 
 // Section 8.3 DAC Volume and Mixing
 #define CODEC_DAC_VOL								(uint8_t)0x03
 #define CODEC_DAC_VOL_CH_VOL_TRACKING				(uint8_t)0x40
-#define CODEC_DAC_VOL_SOFT_RAMP						(uint8_t)(((x) & 0x03) << 4)
-#define CODEC_DAC_VOL_ATAPI							(uint8_t)(((x) & 0x0F) << 0)
+#define CODEC_DAC_VOL_SOFT_RAMP(x)					(uint8_t)(((x) & 0x03) << 4)
+#define CODEC_DAC_VOL_ATAPI(x)						(uint8_t)(((x) & 0x0F) << 0)
 
 // Section 8.4 DAC Channel A volume
 #define CODEC_DAC_CHA_VOL							(uint8_t)0x04
 #define CODEC_DAC_CHA_VOL_MUTE						(uint8_t)0x80
-#define CODEC_DAC_CHA_VOL_VOLUME					(uint8_t)(((x) & 0x7F) << 0)
+#define CODEC_DAC_CHA_VOL_VOLUME(x)					(uint8_t)(((x) & 0x7F) << 0)
 
 // Section 8.5 DAC Channel B volume
 #define CODEC_DAC_CHB_VOL							(uint8_t)0x05
 #define CODEC_DAC_CHB_VOL_MUTE						(uint8_t)0x80
-#define CODEC_DAC_CHB_VOL_VOLUME					(uint8_t)(((x) & 0x7F) << 0)
+#define CODEC_DAC_CHB_VOL_VOLUME(x)					(uint8_t)(((x) & 0x7F) << 0)
 
 // Section 8.6 ADC Control
 #define CODEC_ADC_CTRL								(uint8_t)0x06
 #define CODEC_ADC_CTRL_DITHER						(uint8_t)0x20
 #define CODEC_ADC_CTRL_SER_FORMAT					(uint8_t)0x10
-#define CODEC_ADC_CTRL_MUTE							(uint8_t)(((x) & 0x03) << 2)
-#define CODEC_ADC_CTRL_HPF							(uint8_t)(((x) & 0x03) << 0)
+#define CODEC_ADC_CTRL_MUTE(x)						(uint8_t)(((x) & 0x03) << 2)
+#define CODEC_ADC_CTRL_HPF(x)						(uint8_t)(((x) & 0x03) << 0)
 
 // Section 8.7 Mode Control 2
 #define CODEC_MODE_CTRL2							(uint8_t)0x07
@@ -88,7 +88,7 @@ void codec_init(XIOModule *inst);
 
 // Section 8.8 Chip ID
 #define CODEC_CHIP_ID								(uint8_t)0x08
-#define CODEC_CHIP_ID_PART							(uint8_t)(((x) & 0x0F) << 4)
-#define CODEC_CHIP_ID_REV							(uint8_t)(((x) & 0x0F) << 0)
+#define CODEC_CHIP_ID_PART(x)						(uint8_t)(((x) & 0x0F) << 4)
+#define CODEC_CHIP_ID_REV(x)						(uint8_t)(((x) & 0x0F) << 0)
 
 #endif
@@ -0,0 +1,162 @@
+/******************************************************************************
+* Sine loopback test for SuperAudioBoard
+*
+* compress.c
+*
+* Lossless compression of capture data, a small subset of the FLAC
+* approach: each block of samples goes through a fixed polynomial predictor
+* (order 0, 1 or 2, whichever leaves the smallest residuals) and the
+* residuals are Rice coded.  What's left after prediction is mostly noise,
+* so the saving depends on the noise level of the capture.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#include "compress.h"
+
+#if defined(__MK20DX128__) || defined(__MK20DX256__)
+#include "mk20dx128.h"
+#else
+// Host tools build (HostCapture)
+#define FASTRUN
+#endif
+
+typedef struct
+{
+	uint8_t *p;
+	uint64_t acc;
+	uint8_t bits;
+} bit_writer_t;
+
+// Append the low n bits of val (n <= 32, val < 2^n)
+static inline void put_bits(bit_writer_t *bw, uint32_t val, uint8_t n)
+{
+	bw->acc = (bw->acc << n) | val;
+	bw->bits += n;
+	while(bw->bits >= 8)
+	{
+		bw->bits -= 8;
+		*bw->p++ = (uint8_t)(bw->acc >> bw->bits);
+	}
+}
+
+static inline uint32_t zigzag(uint32_t e)
+{
+	return (e << 1) ^ (uint32_t)((int32_t)e >> 31);
+}
+
+// Prediction residual of sample i for the given order, modulo 2^32
+static inline uint32_t residual(const int32_t *x, uint32_t i, uint8_t order)
+{
+	if(order == 0)
+		return (uint32_t)x[i];
+	if(order == 1)
+		return (uint32_t)x[i] - (uint32_t)x[i - 1];
+	return (uint32_t)x[i] - 2*(uint32_t)x[i - 1] + (uint32_t)x[i - 2];
+}
+
+FASTRUN static void encode_channel(bit_writer_t *bw, const int32_t *x, uint16_t n)
+{
+	uint64_t sum[COMPRESS_MAX_ORDER + 1] = { 0, 0, 0 };
+	uint64_t count;
+	uint32_t i, u, q;
+	uint8_t order, k;
+
+	// Pick the order with the smallest residuals, over the samples that
+	// all orders predict
+	for(i = COMPRESS_MAX_ORDER; i < n; i++)
+	{
+		sum[0] += zigzag(residual(x, i, 0));
+		sum[1] += zigzag(residual(x, i, 1));
+		sum[2] += zigzag(residual(x, i, 2));
+	}
+	order = 0;
+	if(n > COMPRESS_MAX_ORDER)
+	{
+		if(sum[1] < sum[order])
+			order = 1;
+		if(sum[2] < sum[order])
+			order = 2;
+	}
+
+	// k is about log2 of the mean residual
+	k = 0;
+	count = n - order;
+	if(count > 0)
+	{
+		while((k < 30) && ((count << (k + 1)) <= sum[order]))
+			k++;
+	}
+
+	put_bits(bw, (order << 5) | k, 7);
+	for(i = 0; (i < order) && (i < n); i++)
+		put_bits(bw, (uint32_t)x[i], 32);
+
+	for(i = order; i < n; i++)
+	{
+		u = zigzag(residual(x, i, order));
+		q = u >> k;
+		if(q >= COMPRESS_RICE_ESC)
+		{
+			put_bits(bw, 0, COMPRESS_RICE_ESC);
+			put_bits(bw, u, 32);
+		}
+		else if(q + 1 + k <= 32)
+		{
+			// Zeros, the terminating 1 and the low bits in one go
+			put_bits(bw, (1UL << k) | (u & ((1UL << k) - 1)), q + 1 + k);
+		}
+		else
+		{
+			put_bits(bw, 1, q + 1);
+			put_bits(bw, u & ((1UL << k) - 1), k);
+		}
+	}
+}
+
+FASTRUN uint32_t compress_frame(const int32_t *ch0, const int32_t *ch1, uint16_t n, uint8_t *out)
+{
+	bit_writer_t bw;
+	uint32_t len;
+
+	bw.p = out + COMPRESS_FRAME_HDR_LEN;
+	bw.acc = 0;
+	bw.bits = 0;
+
+	encode_channel(&bw, ch0, n);
+	encode_channel(&bw, ch1, n);
+	if(bw.bits)
+		put_bits(&bw, 0, 8 - bw.bits);
+
+	len = bw.p - out - COMPRESS_FRAME_HDR_LEN;
+	out[0] = len & 0xFF;
+	out[1] = len >> 8;
+	out[2] = n & 0xFF;
+	out[3] = n >> 8;
+
+	return len + COMPRESS_FRAME_HDR_LEN;
+}
+
+uint32_t compress_end(uint8_t *out)
+{
+	out[0] = out[1] = out[2] = out[3] = 0;
+	return COMPRESS_FRAME_HDR_LEN;
+}
@@ -0,0 +1,87 @@
+/******************************************************************************
+* Sine loopback test for SuperAudioBoard
+*
+* compress.h
+*
+* Lossless compression of capture data, a small subset of the FLAC
+* approach: each block of samples goes through a fixed polynomial predictor
+* (order 0, 1 or 2, whichever leaves the smallest residuals) and the
+* residuals are Rice coded.  What's left after prediction is mostly noise,
+* so the saving depends on the noise level of the capture.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Stream format
+//
+// The stream is a series of frames, each holding the same number of
+// samples from two channels, and ends with an empty frame (length and
+// sample count both 0).  Frame header, little endian:
+//
+//   uint16_t  payload length in bytes
+//   uint16_t  samples per channel
+//
+// The payload is a bit stream, most significant bit first, with channel 0
+// then channel 1, padded with 0s to a whole byte at the end:
+//
+//   2 bits    predictor order
+//   5 bits    Rice parameter k
+//   order x 32 bits   warm up samples, as is
+//   residuals for the rest of the samples, Rice coded
+//
+// Residuals are calculated modulo 2^32, so any int32_t input round trips.
+// Each is zigzag mapped to unsigned (0, -1, 1, -2, ... -> 0, 1, 2, 3, ...),
+// then sent as (u >> k) zeros, a 1, and the low k bits of u.  If u >> k is
+// COMPRESS_RICE_ESC or more, COMPRESS_RICE_ESC zeros are sent followed by
+// all 32 bits of u instead.
+
+#define COMPRESS_RICE_ESC		24
+#define COMPRESS_MAX_ORDER		2
+#define COMPRESS_FRAME_HDR_LEN	4
+
+// Samples per channel in each frame the sine test sends
+#define COMPRESS_BLOCK_LEN		128
+
+// Worst case size of a frame of n samples per channel, header included
+#define COMPRESS_FRAME_MAX(n)	(COMPRESS_FRAME_HDR_LEN + 2*(1 + 4*COMPRESS_MAX_ORDER + 7*(n)) + 1)
+
+// Encode n samples from each channel (n <= 0xFFFF) into one frame.  out
+// must have room for COMPRESS_FRAME_MAX(n) bytes.  Returns the number of
+// bytes written.
+uint32_t compress_frame(const int32_t *ch0, const int32_t *ch1, uint16_t n, uint8_t *out);
+
+// Write the end of stream frame.  Returns the number of bytes written.
+uint32_t compress_end(uint8_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -25,14 +25,70 @@
 #include "i2c.h"
 #include "delay.h"
 #include "mk20dx128.h"
+#include "core_pins.h"
 
 
-// Setup I2C address for codec
-#define CODEC_ADDR 0x10 
+// I2C address of the first codec, the second board has its AD0 strap
+// pulled high
+#define CODEC_ADDR_BASE 0x10 
+#define CODEC_ADDR(board) (CODEC_ADDR_BASE + (board))
 
+// The datasheet wants the control port enabled within 10ms of releasing
+// reset, so give up on the codec after that
+#define CODEC_READY_TIMEOUT_MS 10
 
-void codec_write(uint8_t reg, uint8_t data)
+// How often codec_poll() has another go at a level change the codec
+// didn't take, and how many goes it gets before the codec is taken to be
+// down (absent, or not set up by INIT yet)
+#define CODEC_RETRY_MS 100
+#define CODEC_RETRIES 3
+
+#define REG_BIT(reg) (1 << (reg))
+
+// Per codec state.  regs[] is the shadow copy of the register file,
+// indexed by register number.  A bit in valid means the entry matches (or
+// is about to match) the codec, a bit in dirty means it hasn't been
+// written yet.  The level_ fields are for the background writes of the
+// two DAC channel volume registers.
+typedef struct
+{
+	uint8_t addr;
+	uint8_t regs[CODEC_NUM_REGS + 1];
+	uint16_t valid;
+	uint16_t dirty;
+
+	i2c_transaction_t level_xfer;
+	uint8_t level_buf[3];
+	volatile uint8_t level_again;
+	volatile uint8_t level_failed;
+	uint8_t level_retries;
+} codec_state_t;
+
+static codec_state_t codecs[CODEC_NUM_BOARDS];
+
+// The codec the codec_*() calls go to, see codec_select()
+static codec_state_t *cur = &codecs[0];
+
+static void level_start(codec_state_t *c);
+static void level_done(i2c_transaction_t *t);
+static uint8_t codec_setup(uint8_t board);
+
+
+void codec_select(uint8_t board)
 {
+	if(board < CODEC_NUM_BOARDS)
+		cur = &codecs[board];
+}
+
+uint8_t codec_selected(void)
+{
+	return cur - codecs;
+}
+
+uint8_t codec_write(uint8_t reg, uint8_t data)
+{
+	uint8_t err;
+
 	// For CS4272 all data is written between single
 	// start/stop sequence
 	
@@ -41,39 +97,348 @@ void codec_write(uint8_t reg, uint8_t data)
 	buf[0] = reg;
 	buf[1] = data;
 
-	i2c_write(CODEC_ADDR,2,buf);
+	err = i2c_write(cur->addr,2,buf);
+	if(err == 0 && reg <= CODEC_NUM_REGS)
+	{
+		uint32_t primask = __save_irq();
 
+		cur->regs[reg] = data;
+		cur->valid |= REG_BIT(reg);
+		cur->dirty &= ~REG_BIT(reg);
+		__restore_irq(primask);
+	}
+
+	return err;
 }
 
 uint8_t codec_read(uint8_t reg)
 {
-	// No waveform demo for read,
-	// so assume first write MAP,
-	// then rep-start (or stop and start),
-	// the read
-	
-	i2c_write(CODEC_ADDR,1,&reg);
+	// Registers only change when we write them, so serve from the
+	// shadow copy when it's there
+	if(reg <= CODEC_NUM_REGS && (cur->valid & REG_BIT(reg)))
+	{
+		return cur->regs[reg];
+	}
 
+	// Write the MAP, then a repeated start turns the bus around for
+	// the read, all in one transaction
 	uint8_t buf;
-	if(i2c_read(CODEC_ADDR,1,&buf) != 1)
+	if(i2c_write_read(cur->addr,1,&reg,1,&buf) != 0)
 	{
 		return 0;
 	}
 
+	if(reg <= CODEC_NUM_REGS)
+	{
+		uint32_t primask = __save_irq();
+
+		// Don't clobber a change made from an interrupt meanwhile
+		if(!(cur->dirty & REG_BIT(reg)))
+			cur->regs[reg] = buf;
+		cur->valid |= REG_BIT(reg);
+		__restore_irq(primask);
+	}
+
 	return buf;
 }
 
-void codec_init()
+void codec_set(uint8_t reg, uint8_t data)
+{
+	uint32_t primask;
+
+	// Chip ID is read only
+	if((reg < CODEC_MODE_CONTROL) || (reg >= CODEC_CHIP_ID))
+		return;
+
+	primask = __save_irq();
+	if(!(cur->valid & REG_BIT(reg)) || (cur->regs[reg] != data))
+	{
+		cur->regs[reg] = data;
+		cur->valid |= REG_BIT(reg);
+		cur->dirty |= REG_BIT(reg);
+	}
+	__restore_irq(primask);
+}
+
+void codec_modify(uint8_t reg, uint8_t mask, uint8_t data)
 {
+	uint32_t primask;
+	uint8_t old;
+
+	if((reg < CODEC_MODE_CONTROL) || (reg >= CODEC_CHIP_ID))
+		return;
+
+	// Fetch it into the shadow copy if need be, then modify the copy in
+	// one go so a change from an interrupt in between isn't lost
+	old = codec_read(reg);
+	primask = __save_irq();
+	if(cur->valid & REG_BIT(reg))
+		old = cur->regs[reg];
+	codec_set(reg, (old & ~mask) | (data & mask));
+	__restore_irq(primask);
+}
+
+uint8_t codec_sync(void)
+{
+	uint8_t data[CODEC_NUM_REGS];
+	uint8_t first, last, reg, err;
+	uint16_t span, written;
+	uint32_t primask;
+
+	// A background level write that didn't make it
+	primask = __save_irq();
+	if(cur->level_failed)
+	{
+		cur->level_failed = 0;
+		cur->dirty |= REG_BIT(CODEC_DAC_CHA_VOL) | REG_BIT(CODEC_DAC_CHB_VOL);
+	}
+	__restore_irq(primask);
+
+	while(cur->dirty)
+	{
+		// Lowest dirty register, then extend the burst over every
+		// register after it that we know the value of, up to the
+		// highest dirty one.  Copy the values and mark them written in
+		// one go, so a change from an interrupt while the burst is going
+		// out stays dirty.
+		primask = __save_irq();
+		for(first = CODEC_MODE_CONTROL; !(cur->dirty & REG_BIT(first)); first++)
+			;
+		last = first;
+		for(reg = first + 1; reg < CODEC_CHIP_ID; reg++)
+		{
+			if(!(cur->valid & REG_BIT(reg)))
+				break;
+			if(cur->dirty & REG_BIT(reg))
+				last = reg;
+		}
+		span = 0;
+		for(reg = first; reg <= last; reg++)
+		{
+			data[reg - first] = cur->regs[reg];
+			span |= REG_BIT(reg);
+		}
+		written = cur->dirty & span;
+		cur->dirty &= ~span;
+		__restore_irq(primask);
+
+		err = codec_write_burst(first, data, last - first + 1);
+		if(err)
+		{
+			primask = __save_irq();
+			cur->dirty |= written;
+			__restore_irq(primask);
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+uint8_t codec_refresh(void)
+{
+	uint8_t regs[CODEC_NUM_REGS];
+	uint8_t err, reg;
+	uint32_t primask;
+
+	err = codec_read_all(regs);
+	if(err)
+		return err;
+
+	// Keep changes that haven't been written yet
+	primask = __save_irq();
+	for(reg = CODEC_MODE_CONTROL; reg <= CODEC_NUM_REGS; reg++)
+	{
+		if(!(cur->dirty & REG_BIT(reg)))
+			cur->regs[reg] = regs[reg - 1];
+	}
+	cur->valid = 0x1FE;
+	__restore_irq(primask);
+
+	return 0;
+}
+
+uint8_t codec_write_burst(uint8_t reg, const uint8_t *data, uint8_t num)
+{
+	uint8_t buf[CODEC_NUM_REGS + 1];
+	uint8_t i;
+
+	if(num > CODEC_NUM_REGS)
+		return I2C_WRT_ERR_TOO_MANY_BYTES;
+
+	// MAP with the increment bit, then the data for each register in turn
+	buf[0] = reg | CODEC_MAP_INCR;
+	for(i = 0; i < num; i++)
+		buf[i + 1] = data[i];
+
+	return i2c_write(cur->addr, num + 1, buf);
+}
+
+uint8_t codec_read_burst(uint8_t reg, uint8_t *data, uint8_t num)
+{
+	uint8_t map = reg | CODEC_MAP_INCR;
+
+	// Set the MAP like codec_read(), then the registers come back one
+	// after another after the repeated start
+	return i2c_write_read(cur->addr, 1, &map, num, data);
+}
+
+void codec_set_volume(uint8_t atten_left, uint8_t atten_right)
+{
+	uint32_t primask;
+
+	if(atten_left > CODEC_ATTEN_MAX)
+		atten_left = CODEC_ATTEN_MAX;
+	if(atten_right > CODEC_ATTEN_MAX)
+		atten_right = CODEC_ATTEN_MAX;
+
+	primask = __save_irq();
+	codec_set(CODEC_DAC_CHA_VOL, (cur->regs[CODEC_DAC_CHA_VOL] & CODEC_DAC_CHA_VOL_MUTE)
+			| CODEC_DAC_CHA_VOL_VOLUME(atten_left));
+	codec_set(CODEC_DAC_CHB_VOL, (cur->regs[CODEC_DAC_CHB_VOL] & CODEC_DAC_CHB_VOL_MUTE)
+			| CODEC_DAC_CHB_VOL_VOLUME(atten_right));
+	cur->level_retries = 0;
+	level_start(cur);
+	__restore_irq(primask);
+}
+
+void codec_set_mute(uint8_t mute)
+{
+	uint32_t primask;
+	uint8_t a, b;
+
+	primask = __save_irq();
+	a = cur->regs[CODEC_DAC_CHA_VOL] & ~CODEC_DAC_CHA_VOL_MUTE;
+	b = cur->regs[CODEC_DAC_CHB_VOL] & ~CODEC_DAC_CHB_VOL_MUTE;
+	if(mute)
+	{
+		a |= CODEC_DAC_CHA_VOL_MUTE;
+		b |= CODEC_DAC_CHB_VOL_MUTE;
+	}
+	codec_set(CODEC_DAC_CHA_VOL, a);
+	codec_set(CODEC_DAC_CHB_VOL, b);
+	cur->level_retries = 0;
+	level_start(cur);
+	__restore_irq(primask);
+}
+
+uint8_t codec_level_busy(void)
+{
+	return (cur->level_xfer.status == I2C_STATUS_PENDING) || cur->level_again;
+}
+
+// Queue a burst write of the channel volume registers from the shadow
+// copy, or flag that another one is needed if one is already going.
+// Safe from any interrupt, including the I2C one.
+static void level_start(codec_state_t *c)
+{
+	uint32_t primask = __save_irq();
+
+	if(c->level_xfer.status == I2C_STATUS_PENDING)
+	{
+		c->level_again = 1;
+		__restore_irq(primask);
+		return;
+	}
+	c->level_again = 0;
+
+	// Nothing to do if codec_sync() got there first
+	if(!(c->dirty & (REG_BIT(CODEC_DAC_CHA_VOL) | REG_BIT(CODEC_DAC_CHB_VOL))))
+	{
+		__restore_irq(primask);
+		return;
+	}
+
+	c->level_buf[0] = CODEC_DAC_CHA_VOL | CODEC_MAP_INCR;
+	c->level_buf[1] = c->regs[CODEC_DAC_CHA_VOL];
+	c->level_buf[2] = c->regs[CODEC_DAC_CHB_VOL];
+	c->dirty &= ~(REG_BIT(CODEC_DAC_CHA_VOL) | REG_BIT(CODEC_DAC_CHB_VOL));
+
+	c->level_xfer.address = c->addr;
+	c->level_xfer.tx_len = 3;
+	c->level_xfer.rx_len = 0;
+	c->level_xfer.tx_buf = c->level_buf;
+	c->level_xfer.rx_buf = NULL;
+	c->level_xfer.callback = level_done;
+	c->level_xfer.user = c;
+	i2c_submit(&c->level_xfer);
+	__restore_irq(primask);
+}
+
+// I2C interrupt, the volume write is finished
+static void level_done(i2c_transaction_t *t)
+{
+	codec_state_t *c = t->user;
+
+	// Don't keep hammering a codec that isn't answering, codec_poll()
+	// or codec_sync() pick the registers up again instead
+	if(t->status != I2C_STATUS_OK)
+		c->level_failed = 1;
+	else
+		c->level_retries = 0;
+
+	if(c->level_again)
+		level_start(c);
+}
+
+uint8_t codec_poll(void)
+{
+	static uint32_t last_try = 0;
+	codec_state_t *c;
+	uint32_t primask;
+
+	if((millis() - last_try) < CODEC_RETRY_MS)
+		return 0;
+	last_try = millis();
+
+	for(c = codecs; c < codecs + CODEC_NUM_BOARDS; c++)
+	{
+		// Once the retries are used up level_failed stays set, and the
+		// next codec_sync() or level change tries again
+		primask = __save_irq();
+		if(c->level_failed && (c->level_retries < CODEC_RETRIES)
+				&& (c->level_xfer.status != I2C_STATUS_PENDING))
+		{
+			c->level_failed = 0;
+			c->level_retries++;
+			c->dirty |= REG_BIT(CODEC_DAC_CHA_VOL) | REG_BIT(CODEC_DAC_CHB_VOL);
+			level_start(c);
+		}
+		__restore_irq(primask);
+	}
+
+	return 0;
+}
+
+uint8_t codec_init()
+{
+	uint8_t board, err = 0;
+	uint32_t primask;
+
 	// Setup Initial Codec
 	
-	// Initialize I2C
+	// Initialize I2C (nothing to wait for, transfers poll the bus)
 	i2c_init();
-	delay(100);
+
+	// Reset puts every register back to its default.  Let any level
+	// write that's still queued finish first.
+	for(board = 0; board < CODEC_NUM_BOARDS; board++)
+	{
+		while((codecs[board].level_xfer.status == I2C_STATUS_PENDING)
+				|| codecs[board].level_again)
+			;
+		primask = __save_irq();
+		codecs[board].addr = CODEC_ADDR(board);
+		codecs[board].valid = 0;
+		codecs[board].dirty = 0;
+		codecs[board].level_failed = 0;
+		codecs[board].level_retries = 0;
+		__restore_irq(primask);
+	}
 
 	// Setup Reset pin (GPIO)
 	// Right now assuming that we're using Teensy pin 2
-	// which is Port D pin 0
+	// which is Port D pin 0.  With more than one board they all share it.
 	
 	// Setup Pin muxing for GPIO (alt 1)
 	PORTD_PCR0 = PORT_PCR_MUX(1);
@@ -88,26 +453,68 @@ void codec_init()
 	
 	// Release Reset (drive pin high)
 	GPIOD_PSOR = (1 << 0);
-	
-	// Wait for ~2-5ms (1-10 ms time window spec'd in datasheet)
-	delay(2);
-	
+
+	// Slaves first, so they're ready for the clocks when the master
+	// starts up
+	board = CODEC_NUM_BOARDS;
+	while(board-- > 0)
+	{
+		err = codec_setup(board);
+		if(err)
+			break;
+	}
+
+	codec_select(0);
+	return err;
+}
+
+// Bring up one codec, which has just come out of reset
+static uint8_t codec_setup(uint8_t board)
+{
+	uint32_t start;
+	uint8_t err;
+
+	codec_select(board);
+
 	// Set power down and control port enable as spec'd in the 
-	// datasheet for control port mode
-	codec_write(CODEC_MODE_CTRL2, CODEC_MODE_CTRL2_POWER_DOWN
-			| CODEC_MODE_CTRL2_CTRL_PORT_EN);
-	
-	// Further setup
-	delay(1);
+	// datasheet for control port mode.  Rather than waiting a fixed
+	// couple of ms, keep trying until the codec acks (it NAKs until it's
+	// out of reset).
+	start = millis();
+	while((err = codec_write(CODEC_MODE_CTRL2, CODEC_MODE_CTRL2_POWER_DOWN
+			| CODEC_MODE_CTRL2_CTRL_PORT_EN)) != 0)
+	{
+		if((millis() - start) > CODEC_READY_TIMEOUT_MS)
+			return err;
+	}
 
-	// Set ratio select for MCLK=512*LRCLK (BCLK = 64*LRCLK), and master mode
-	codec_write(CODEC_MODE_CONTROL, CODEC_MC_RATIO_SEL(2) | CODEC_MC_MASTER_SLAVE);
+	if(board == 0)
+	{
+		// Set ratio select for MCLK=512*LRCLK (BCLK = 64*LRCLK), and master mode
+		codec_write(CODEC_MODE_CONTROL, CODEC_MC_RATIO_SEL(2) | CODEC_MC_MASTER_SLAVE);
+	}
+	else
+	{
+		// The other boards run off the first board's clocks (the MCLK
+		// to LRCLK ratio is detected automatically in slave mode)
+		codec_write(CODEC_MODE_CONTROL, 0);
+	}
 
-	delay(10);
+	// Register writes take effect at the end of each byte, so there's no
+	// need to wait before powering up
 	
+	// Ramp volume and mute changes on zero crossings so level steps
+	// during a test don't click
+	codec_write(CODEC_DAC_VOL, CODEC_DAC_VOL_SOFT_RAMP(CODEC_RAMP_SOFT_ZERO_CROSS)
+			| CODEC_DAC_VOL_ATAPI(CODEC_ATAPI_STEREO));
+
 	// Release power down bit to start up codec
 	codec_write(CODEC_MODE_CTRL2, CODEC_MODE_CTRL2_CTRL_PORT_EN);
 	
-	// Wait for everything to come up
-	delay(10);
+	// No fixed wait for the codec to power up here, the master starts
+	// driving the I2S clocks once it's running and the caller watches
+	// for that
+
+	// One burst to fill in the shadow copy
+	return codec_refresh();
 }
@@ -32,10 +32,83 @@
 
 #include <stdint.h>
 
-void codec_write(uint8_t reg, uint8_t data);
+// Number of SuperAudioBoards on the bus.  Board 0 is the I2S master and
+// is at I2C address 0x10, the others share its MCLK, BCLK and LRCLK and
+// have their AD0 strap high (address 0x11).  The CS4272 only has the one
+// address pin and the I2S block only has two data lines each way, so two
+// boards is the limit.
+#ifndef NUM_BOARDS
+#define NUM_BOARDS 1
+#endif
+#define CODEC_NUM_BOARDS NUM_BOARDS
+
+#if (CODEC_NUM_BOARDS < 1) || (CODEC_NUM_BOARDS > 2)
+#error "NUM_BOARDS must be 1 or 2"
+#endif
+
+// Pick the board the other codec_*() calls talk to (0 to
+// CODEC_NUM_BOARDS - 1, anything else is ignored).  Every board has its
+// own shadow copy.  codec_init() sets up all of them and leaves board 0
+// selected.
+void codec_select(uint8_t board);
+uint8_t codec_selected(void);
+
+// Returns 0 or an I2C error code
+uint8_t codec_write(uint8_t reg, uint8_t data);
 uint8_t codec_read(uint8_t reg);
 
-void codec_init();
+// Write or read num consecutive registers starting at reg in a single
+// I2C transaction, using MAP auto increment.  Return 0 on success or an
+// I2C error code.
+uint8_t codec_write_burst(uint8_t reg, const uint8_t *data, uint8_t num);
+uint8_t codec_read_burst(uint8_t reg, uint8_t *data, uint8_t num);
+
+// Read the whole register file (registers 1 to 8) into regs[0..7]
+#define codec_read_all(regs) codec_read_burst(CODEC_MODE_CONTROL, (regs), CODEC_NUM_REGS)
+
+// Register shadow copy.  codec_write() writes through and codec_read()
+// answers from the copy once a register is known.  codec_set() and
+// codec_modify() only change the copy; codec_sync() then writes every
+// changed register in one burst.  Returns 0 or an I2C error code.
+void codec_set(uint8_t reg, uint8_t data);
+void codec_modify(uint8_t reg, uint8_t mask, uint8_t data);
+uint8_t codec_sync(void);
+
+// Reload the shadow copy from the codec (one burst), keeping changes
+// that haven't been synced.  Returns 0 or an I2C error code.
+uint8_t codec_refresh(void);
+
+// DAC level control.  These only update the shadow copy and queue a write
+// of both channel volume registers in the background, so they can be
+// called while audio is running (even from an interrupt) without waiting
+// on the bus.  A change made while the last one is still going out is
+// picked up when it finishes.  codec_init() sets the codec up to ramp
+// level changes on zero crossings, so steps don't click.
+//
+// Attenuation is in dB below full scale, 0 to CODEC_ATTEN_MAX.
+#define CODEC_ATTEN_MAX 127
+void codec_set_volume(uint8_t atten_left, uint8_t atten_right);
+void codec_set_mute(uint8_t mute);
+
+// Nonzero while a level change is still on its way to the codec
+uint8_t codec_level_busy(void);
+
+// Background housekeeping, for sched_add().  Retries level changes that
+// didn't make it to the codec (every board, not just the selected one),
+// a few times and then leaves them for the next codec_sync().
+uint8_t codec_poll(void);
+
+// Reset and set up the codecs.  Returns as soon as every board's control
+// port has taken the setup (0), or an I2C error code if a codec never
+// answered.  The codecs are still powering up at that point; they're
+// ready once board 0 is driving the I2S clocks.
+uint8_t codec_init();
+
+// Memory address pointer (MAP) auto increment bit
+#define CODEC_MAP_INCR								(uint8_t)0x80
+
+// Registers 1 (mode control) through 8 (chip ID)
+#define CODEC_NUM_REGS								8
 
 // Section 8.1 Mode Control
 #define CODEC_MODE_CONTROL							(uint8_t)0x01
@@ -48,33 +121,43 @@ void codec_init();
 #define CODEC_DAC_CONTROL							(uint8_t)0x02
 #define CODEC_DAC_CTRL_AUTO_MUTE					(uint8_t)0x80
 #define CODEC_DAC_CTRL_FILTER_SEL					(uint8_t)0x40
-#define CODEC_DAC_CTRL_DE_EMPHASIS					(uint8_t)(((x) & 0x03) << 4)
+#define CODEC_DAC_CTRL_DE_EMPHASIS(x)				(uint8_t)(((x) & 0x03) << 4)
 #define CODEC_DAC_CTRL_VOL_RAMP_UP					(uint8_t)0x08
 #define CODEC_DAC_CTRL_VOL_RAMP_DN					(uint8_t)0x04
-#define CODEC_DAC_CTRL_INV_POL						(uint8_t)(((x) & 0x03) << 0)
+#define CODEC_DAC_CTRL_INV_POL(x)					(uint8_t)(((x) & 0x03) << 0)
 
 // Section 8.3 DAC Volume and Mixing
 #define CODEC_DAC_VOL								(uint8_t)0x03
 #define CODEC_DAC_VOL_CH_VOL_TRACKING				(uint8_t)0x40
-#define CODEC_DAC_VOL_SOFT_RAMP						(uint8_t)(((x) & 0x03) << 4)
-#define CODEC_DAC_VOL_ATAPI							(uint8_t)(((x) & 0x0F) << 0)
+#define CODEC_DAC_VOL_SOFT_RAMP(x)					(uint8_t)(((x) & 0x03) << 4)
+#define CODEC_DAC_VOL_ATAPI(x)						(uint8_t)(((x) & 0x0F) << 0)
+
+// CODEC_DAC_VOL_SOFT_RAMP() settings for how volume and mute changes
+// are applied
+#define CODEC_RAMP_IMMEDIATE						0
+#define CODEC_RAMP_ZERO_CROSS						1
+#define CODEC_RAMP_SOFT								2
+#define CODEC_RAMP_SOFT_ZERO_CROSS					3
+
+// CODEC_DAC_VOL_ATAPI() setting for left to channel A, right to B
+#define CODEC_ATAPI_STEREO							9
 
 // Section 8.4 DAC Channel A volume
 #define CODEC_DAC_CHA_VOL							(uint8_t)0x04
 #define CODEC_DAC_CHA_VOL_MUTE						(uint8_t)0x80
-#define CODEC_DAC_CHA_VOL_VOLUME					(uint8_t)(((x) & 0x7F) << 0)
+#define CODEC_DAC_CHA_VOL_VOLUME(x)					(uint8_t)(((x) & 0x7F) << 0)
 
 // Section 8.5 DAC Channel B volume
 #define CODEC_DAC_CHB_VOL							(uint8_t)0x05
 #define CODEC_DAC_CHB_VOL_MUTE						(uint8_t)0x80
-#define CODEC_DAC_CHB_VOL_VOLUME					(uint8_t)(((x) & 0x7F) << 0)
+#define CODEC_DAC_CHB_VOL_VOLUME(x)					(uint8_t)(((x) & 0x7F) << 0)
 
 // Section 8.6 ADC Control
 #define CODEC_ADC_CTRL								(uint8_t)0x06
 #define CODEC_ADC_CTRL_DITHER						(uint8_t)0x20
 #define CODEC_ADC_CTRL_SER_FORMAT					(uint8_t)0x10
-#define CODEC_ADC_CTRL_MUTE							(uint8_t)(((x) & 0x03) << 2)
-#define CODEC_ADC_CTRL_HPF							(uint8_t)(((x) & 0x03) << 0)
+#define CODEC_ADC_CTRL_MUTE(x)						(uint8_t)(((x) & 0x03) << 2)
+#define CODEC_ADC_CTRL_HPF(x)						(uint8_t)(((x) & 0x03) << 0)
 
 // Section 8.7 Mode Control 2
 #define CODEC_MODE_CTRL2							(uint8_t)0x07
@@ -86,7 +169,7 @@ void codec_init();
 
 // Section 8.8 Chip ID
 #define CODEC_CHIP_ID								(uint8_t)0x08
-#define CODEC_CHIP_ID_PART							(uint8_t)(((x) & 0x0F) << 4)
-#define CODEC_CHIP_ID_REV							(uint8_t)(((x) & 0x0F) << 0)
+#define CODEC_CHIP_ID_PART(x)						(uint8_t)(((x) & 0x0F) << 4)
+#define CODEC_CHIP_ID_REV(x)						(uint8_t)(((x) & 0x0F) << 0)
 
 #endif
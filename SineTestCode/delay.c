@@ -4,6 +4,10 @@
 // delay() and micros() for when semi-accurate delays are necessary
 // during execution.
 // William Hollender, 5/1/14
+//
+// Time comes from SysTick: the millisecond count plus how far the
+// counter is into the current millisecond.  The DWT cycle counter is no
+// good for this, it stops whenever yield() sleeps the core.
 //////////////////////////////////////////////////////////////////////////
 
 #include "mk20dx128.h"
@@ -14,38 +18,35 @@ extern void yield();
 // the systick interrupt is supposed to increment this at 1 kHz rate
 volatile uint32_t systick_millis_count = 0;
 
-//uint32_t systick_current, systick_count, systick_istatus;  // testing only
+uint64_t micros64(void)
+{
+	uint32_t count, current, pending;
+
+	// Read the count on both sides of the counter instead of masking
+	// interrupts, and go again if the tick interrupt ran in between.  A
+	// tick that's pending but can't run yet (interrupts are off, or this
+	// is a handler it can't preempt) is counted once the counter has
+	// reloaded.
+	do {
+		count = systick_millis_count;
+		current = SYST_CVR;
+		pending = SCB_ICSR & SCB_ICSR_PENDSTSET;
+	} while(count != systick_millis_count);
+	if(pending && current > 50)
+		count++;
+	current = ((F_CPU / 1000) - 1) - current;
+	return (uint64_t)count * 1000 + current / (F_CPU / 1000000);
+}
 
 uint32_t micros(void)
 {
-	uint32_t count, current, istatus;
-
-	__disable_irq();
-	current = SYST_CVR;
-	count = systick_millis_count;
-	istatus = SCB_ICSR;	// bit 26 indicates if systick exception pending
-	__enable_irq();
-	 //systick_current = current;
-	 //systick_count = count;
-	 //systick_istatus = istatus & SCB_ICSR_PENDSTSET ? 1 : 0;
-	if ((istatus & SCB_ICSR_PENDSTSET) && current > 50) count++;
-	current = ((F_CPU / 1000) - 1) - current;
-	return count * 1000 + current / (F_CPU / 1000000);
+	return (uint32_t)micros64();
 }
 
 void delay(uint32_t ms)
 {
-	uint32_t start = micros();
-
-	if (ms > 0) {
-		while (1) {
-			if ((micros() - start) >= 1000) {
-				ms--;
-				if (ms == 0) return;
-				start += 1000;
-			}
-			yield();
-		}
-	}
-}
+	uint64_t end = micros64() + (uint64_t)ms * 1000;
 
+	while(micros64() < end)
+		yield();
+}
@@ -8,7 +8,12 @@
 #ifndef DELAY_H
 #define DELAY_H
 
+// Microseconds since reset, from SysTick so they keep counting while
+// the core sleeps (micros() wraps after about 71 minutes, micros64()
+// after 49 days along with millis())
+uint64_t micros64(void);
 uint32_t micros(void);
+
 void delay(uint32_t ms);
 
 #endif
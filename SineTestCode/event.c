@@ -0,0 +1,88 @@
+/******************************************************************************
+* Sine loopback test for SuperAudioBoard
+*
+* event.c
+*
+* Event flags set by the interrupt handlers, so the main loop can sleep
+* until something happens instead of spinning.
+*
+* Sleeping is a plain WFI (SLEEPDEEP stays clear), which on the K20 is
+* Wait mode: the core stops but every peripheral keeps going and any
+* interrupt wakes it.  SysTick keeps counting, so millis(), micros() and
+* delay() are unaffected.  The DWT cycle counter runs off the core clock
+* and stops with it, so it only times code that's running (the PROF
+* stages), not waits.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#include "mk20dx128.h"
+#include "core_pins.h"
+#include "event.h"
+
+static volatile uint32_t event_flags = 0;
+
+void event_set(uint32_t events)
+{
+	__disable_irq();
+	event_flags |= events;
+	__enable_irq();
+}
+
+void event_clear(uint32_t events)
+{
+	__disable_irq();
+	event_flags &= ~events;
+	__enable_irq();
+}
+
+uint32_t event_wait(uint32_t mask, uint32_t timeout_ms)
+{
+	uint32_t start = millis();
+	uint32_t got;
+
+	while(1)
+	{
+		// Check and sleep with interrupts off, so an event that comes in
+		// between the two can't be missed.  A pending interrupt still
+		// wakes WFI, and then runs as soon as they're back on.
+		__disable_irq();
+		got = event_flags & mask;
+		if(got)
+		{
+			event_flags &= ~got;
+			__enable_irq();
+			return got;
+		}
+		if(timeout_ms && ((millis() - start) >= timeout_ms))
+		{
+			__enable_irq();
+			return 0;
+		}
+		asm volatile("wfi");
+		__enable_irq();
+	}
+}
+
+void event_idle(void)
+{
+	asm volatile("wfi");
+}
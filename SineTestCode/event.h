@@ -0,0 +1,63 @@
+/******************************************************************************
+* Sine loopback test for SuperAudioBoard
+*
+* event.h
+*
+* Event flags set by the interrupt handlers, so the main loop can sleep
+* until something happens instead of spinning.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#ifndef EVENT_H
+#define EVENT_H
+
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EVENT_USB     0x01  // USB interrupt: packets came in or went out
+#define EVENT_I2C     0x02  // an I2C transaction finished
+#define EVENT_TEST    0x04  // a test run finished
+#define EVENT_SETTLE  0x08  // INIT: first I2S frame, or the ADC has settled
+
+// Set events, from an interrupt or the main loop
+void event_set(uint32_t events);
+
+// Clear events in mask that have already happened
+void event_clear(uint32_t events);
+
+// Sleep until one of the events in mask is set, or timeout_ms has passed
+// (0 waits forever).  Returns the events in mask that were set, and
+// clears them, or 0 on timeout.
+uint32_t event_wait(uint32_t mask, uint32_t timeout_ms);
+
+// Sleep until the next interrupt (of any sort).  The systick interrupt
+// wakes things up at least once a ms.
+void event_idle(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
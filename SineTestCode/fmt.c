@@ -0,0 +1,137 @@
+/******************************************************************************
+* Sine loopback test for SuperAudioBoard
+*
+* fmt.c
+*
+* Fast integer to ASCII formatting for dumping sample data as text.
+*
+* ultoa() does a divide and modulo for every digit and then reverses the
+* string, which adds up to a lot of cycles when printing thousands of
+* samples.  These routines figure out the number of digits first, then
+* fill in the string from the end two digits at a time using a lookup table.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#include "fmt.h"
+
+// All two digit pairs "00" through "99"
+static const char digit_pairs[200] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static uint8_t num_digits(uint32_t val)
+{
+	// Binary search on powers of ten (at most 4 compares)
+	if(val < 100000)
+	{
+		if(val < 100)
+			return (val < 10) ? 1 : 2;
+		if(val < 10000)
+			return (val < 1000) ? 3 : 4;
+		return 5;
+	}
+	if(val < 10000000)
+		return (val < 1000000) ? 6 : 7;
+	if(val < 1000000000)
+		return (val < 100000000) ? 8 : 9;
+	return 10;
+}
+
+uint8_t fmt_u32(uint32_t val, char *buf)
+{
+	uint8_t len = num_digits(val);
+	char *p = buf + len;
+	uint32_t pair;
+
+	// Fill in from the end, two digits per divide
+	while(val >= 100)
+	{
+		pair = (val % 100) * 2;
+		val /= 100;
+		*--p = digit_pairs[pair + 1];
+		*--p = digit_pairs[pair];
+	}
+
+	if(val >= 10)
+	{
+		pair = val * 2;
+		*--p = digit_pairs[pair + 1];
+		*--p = digit_pairs[pair];
+	}
+	else
+	{
+		*--p = '0' + val;
+	}
+
+	return len;
+}
+
+uint8_t fmt_i32(int32_t val, char *buf)
+{
+	if(val < 0)
+	{
+		buf[0] = '-';
+		// Negate as unsigned so INT32_MIN works
+		return fmt_u32(-(uint32_t)val, buf + 1) + 1;
+	}
+
+	return fmt_u32(val, buf);
+}
+
+uint8_t fmt_csv_line(char *buf, int32_t a, int32_t b)
+{
+	uint8_t len;
+
+	len = fmt_i32(a, buf);
+	buf[len++] = ',';
+	len += fmt_i32(b, buf + len);
+	buf[len++] = '\r';
+	buf[len++] = '\n';
+
+	return len;
+}
+
+uint32_t fmt_csv_block(char *buf, uint32_t buf_len, const int32_t *a,
+		const int32_t *b, uint32_t *num)
+{
+	uint32_t used = 0;
+	uint32_t lines = 0;
+
+	// Only format a line if the worst case length is guaranteed to fit,
+	// so we never have to back out a partial line
+	while((lines < *num) && ((buf_len - used) >= FMT_CSV_LINE_MAX_LEN))
+	{
+		used += fmt_csv_line(buf + used, a[lines], b[lines]);
+		lines++;
+	}
+
+	*num = lines;
+	return used;
+}
@@ -0,0 +1,63 @@
+/******************************************************************************
+* Sine loopback test for SuperAudioBoard
+*
+* fmt.h
+*
+* Fast integer to ASCII formatting for dumping sample data as text.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#ifndef FMT_H
+#define FMT_H
+
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Longest possible output of fmt_i32() ("-2147483648")
+#define FMT_I32_MAX_LEN       11
+
+// Longest possible output of fmt_csv_line() ("<a>,<b>\r\n")
+#define FMT_CSV_LINE_MAX_LEN  (2*FMT_I32_MAX_LEN + 3)
+
+// Write decimal digits of val to buf (no null terminator).
+// Returns the number of characters written.
+uint8_t fmt_u32(uint32_t val, char *buf);
+uint8_t fmt_i32(int32_t val, char *buf);
+
+// Write one "a,b\r\n" line to buf (no null terminator).
+// Returns the number of characters written.
+uint8_t fmt_csv_line(char *buf, int32_t a, int32_t b);
+
+// Format as many complete lines from a[]/b[] as will fit in buf_len bytes.
+// On entry *num is the number of lines available, on return it is the
+// number of lines actually formatted.  Returns the number of bytes written.
+uint32_t fmt_csv_block(char *buf, uint32_t buf_len, const int32_t *a,
+		const int32_t *b, uint32_t *num);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
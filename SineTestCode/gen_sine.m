@@ -64,7 +64,7 @@ fprintf(outp_file,'*     -- William Hollender
 fprintf(outp_file,'************************************************************************/\n');
 fprintf(outp_file,'\n\n');
 fprintf(outp_file,'#define SIG_LENGTH %d\n', num_samp);
-fprintf(outp_file,'const int32_t out_buf[SIG_LENGTH] = {'); 
+fprintf(outp_file,'const int32_t out_buf[SIG_LENGTH] FASTDATA = {'); 
 
 
 
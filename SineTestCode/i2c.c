@@ -6,6 +6,11 @@
 * Basic I2C implementation for master reads and writes on Teensy 3.x
 * Based pretty heavily on PJRCs implementation of the arduino wire lib
 *
+* Transfers are run from i2c0_isr: transactions are queued with
+* i2c_submit() and go out one after another in the background, with a
+* callback when each one finishes.  i2c_write() and i2c_read() are kept as
+* blocking wrappers around the same engine.
+*
 * Copyright (c) 2015 RF William Hollender, whollender@gmail.com
 * 
 * Permission is hereby granted, free of charge, to any person obtaining a copy
@@ -29,6 +34,7 @@
 
 #include "mk20dx128.h"
 #include "i2c.h"
+#include "event.h"
 
 extern void yield();
 
@@ -38,6 +44,40 @@ static uint8_t i2c_rx_err = 0;
 // I2C initialization state
 static uint8_t i2c_init_flag = 0;
 
+// Transaction queue.  The head is the transaction on the bus.
+static i2c_transaction_t * volatile queue_head = NULL;
+static i2c_transaction_t * volatile queue_tail = NULL;
+
+// Where the ISR is in the current transaction
+#define STATE_IDLE		0
+#define STATE_ADDR_W	1 // address sent for the write part
+#define STATE_TX		2 // sending data bytes
+#define STATE_ADDR_R	3 // address sent for the read part
+#define STATE_RX		4 // receiving data bytes
+#define STATE_WAIT_BUS	5 // waiting for the bus to go idle before the start
+static volatile uint8_t i2c_state = STATE_IDLE;
+static uint8_t i2c_idx;
+
+// How many systick interrupts to wait for the bus to go idle.  The stop
+// only takes a few microseconds, so this is for a stuck bus.
+#define BUS_WAIT_TICKS 10
+static volatile uint8_t bus_wait_ticks = 0;
+
+static void i2c_start_next(void);
+
+// SCL divider for each I2C0_F ICR value (MULT = 1), from the reference
+// manual's I2C divider and hold values table
+static const uint16_t scl_div[64] = {
+	  20,   22,   24,   26,   28,   30,   34,   40,
+	  28,   32,   36,   40,   44,   48,   56,   68,
+	  48,   56,   64,   72,   80,   88,  104,  128,
+	  80,   96,  112,  128,  144,  160,  192,  240,
+	 160,  192,  224,  256,  288,  320,  384,  480,
+	 320,  384,  448,  512,  576,  640,  768,  960,
+	 640,  768,  896, 1024, 1152, 1280, 1536, 1920,
+	1280, 1536, 1792, 2048, 2304, 2560, 3072, 3840
+};
+
 
 // Initialize I2C block
 void i2c_init()
@@ -51,206 +91,354 @@ void i2c_init()
 		PORTB_PCR3 = PORT_PCR_MUX(2)|PORT_PCR_ODE|PORT_PCR_SRE|PORT_PCR_DSE;
 		PORTB_PCR2 = PORT_PCR_MUX(2)|PORT_PCR_ODE|PORT_PCR_SRE|PORT_PCR_DSE;
 
-		// Setup clock divider for 100kHz
-		I2C0_F = 0x27;
-
-		// Setup filter for 4 bus clock cycles
-		I2C0_FLT = 4;
+		// Setup clock divider (0x27 for 100kHz at a 48MHz bus) and
+		// glitch filter
+		i2c_set_clock(I2C_CLOCK);
 
 		// Set high drive
 		I2C0_C2 = I2C_C2_HDRS;
 
 		// and, finally, actually enable the device
 		I2C0_C1 = I2C_C1_IICEN;
+
+		NVIC_ENABLE_IRQ(IRQ_I2C0);
 		
 		i2c_init_flag = 1;
 	}
 }
 
 
-// Write bytes to slave device
-uint8_t i2c_write(uint8_t slave_address, uint8_t num_bytes, const uint8_t *buffer)
+uint32_t i2c_set_clock(uint32_t freq)
 {
-	uint8_t err_code = 0;
-	uint8_t i;
-	uint8_t stat;
+	uint32_t min_div, best, i;
 
-	// Check for num_bytes larger than MAX_BYTES
-	if(num_bytes > I2C_WRT_MAX_BYTES)
+	while(i2c_busy())
+		yield();
+
+	// Smallest divider that doesn't go over freq
+	min_div = (F_BUS + freq - 1) / freq;
+	best = 0x3F;
+	for(i = 0; i < 64; i++)
 	{
-		return I2C_WRT_ERR_TOO_MANY_BYTES;
+		if((scl_div[i] >= min_div) && (scl_div[i] < scl_div[best]))
+			best = i;
 	}
+	I2C0_F = best;
 
-	// This is much simpler than the implementation in Wire because
-	// we don't have to worry about the i2c slave interrupt leaving
-	// the bus in different states
-	
-	// Clear the flags
-	I2C0_S = I2C_S_IICIF | I2C_S_ARBL;
+	// Spike filter in bus clocks: the 4 cycles this has always used at
+	// 100kHz, and about 50ns (the fast mode spec) above that
+	if(freq <= I2C_CLOCK_100K)
+		I2C0_FLT = 4;
+	else
+		I2C0_FLT = F_BUS / 20000000 + 1;
 
-	// TODO: Wait for bus to be free before setting up?
-	// Set up the bus for a master tx
-	
-	// If we're already the master, send a rep start,
-	// otherwise, wait for the bus to clear, then send a start
-	if(I2C0_C1 & I2C_C1_MST)
-	{
-		I2C0_C1 = I2C_C1_IICEN | I2C_C1_MST | I2C_C1_RSTA | I2C_C1_TX;
-	}
+	return F_BUS / scl_div[best];
+}
+
+
+// Queue a transaction.  Safe to call from any interrupt (a completion
+// callback included) or with interrupts disabled.
+uint8_t i2c_submit(i2c_transaction_t *t)
+{
+	uint32_t primask;
+
+	t->status = I2C_STATUS_PENDING;
+	t->next = NULL;
+
+	primask = __save_irq();
+	if(queue_tail)
+		queue_tail->next = t;
 	else
-	{
-		while(I2C0_S & I2C_S_BUSY)
-		{
-			yield();
-		}
+		queue_head = t;
+	queue_tail = t;
 
-		I2C0_C1 = I2C_C1_IICEN | I2C_C1_MST | I2C_C1_TX;
-	}
+	if(i2c_state == STATE_IDLE)
+		i2c_start_next();
+	__restore_irq(primask);
+
+	return 0;
+}
 
-	for(i = 0; i < (num_bytes + 1); i++)
+uint8_t i2c_busy()
+{
+	return (queue_head != NULL);
+}
+
+
+// Send the start condition and address for the transaction at the head
+// of the queue.  Called with the I2C interrupt unable to run.
+static void i2c_start_next(void)
+{
+	i2c_transaction_t *t = queue_head;
+
+	if(!t)
 	{
-		if(i == 0) // Send address byte
-			I2C0_D = slave_address << 1;
-		else // Send data byte
-			I2C0_D = buffer[i-1];
-
-		// Wait for xfer to complete
-		// TODO: Seems weird to poll for interrupt flag instead of
-		// transfer complete flag, but it looks like the interrupt flag will
-		// be set even if arb is lost, no ack sent, etc
-		while (!(I2C0_S & I2C_S_IICIF)) 
-			yield();
-		I2C0_S = I2C_S_IICIF; // clear flag
-
-		// Check for NACK
-		stat = I2C0_S;
-		if(stat & I2C_S_RXAK)
-		{
-			if(i == 0) // NACK on the address byte
-				err_code = I2C_WRT_ERR_ADDR_NACK;
-			else
-				err_code = I2C_WRT_ERR_DATA_NACK;
-			
-			break; // don't try to send any more data
-		}
+		i2c_state = STATE_IDLE;
+		return;
+	}
 
-		if(stat & I2C_S_ARBL)
-		{
-			err_code = I2C_WRT_ERR_LOST_ARB;
+	// Clear the flags
+	I2C0_S = I2C_S_IICIF | I2C_S_ARBL;
 
-			// Clear arb lost flag
-			I2C0_S = I2C_S_ARBL;
+	// Right after a stop the bus stays busy for a few microseconds.
+	// Rather than spin on it (this runs in the I2C interrupt and with
+	// interrupts off), the stop detect interrupt brings us back as soon
+	// as the bus goes idle.  i2c_tick() also comes back every systick,
+	// for a bus that's stuck (or the MK20DX128, which has no stop
+	// detect).  If it's still busy after BUS_WAIT_TICKS the start loses
+	// arbitration and the transaction fails instead of hanging.
+	if((I2C0_S & I2C_S_BUSY) && (bus_wait_ticks < BUS_WAIT_TICKS))
+	{
+		i2c_state = STATE_WAIT_BUS;
+		I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE;
+		I2C0_FLT = I2C_FLT_FLT(I2C0_FLT) | I2C_FLT_STOPF | I2C_FLT_STOPIE;
+
+		// The stop may have come before the old flag was cleared
+		if(!(I2C0_S & I2C_S_BUSY))
+			NVIC_SET_PENDING(IRQ_I2C0);
+		return;
+	}
+	bus_wait_ticks = 0;
 
-			break;
-		}
+	I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TX;
 
+	if(t->tx_len > 0)
+	{
+		i2c_state = STATE_ADDR_W;
+		I2C0_D = t->address << 1;
 	}
+	else
+	{
+		i2c_state = STATE_ADDR_R;
+		I2C0_D = (t->address << 1) | 1;
+	}
+}
+
+// Stop, report the result and move on to the next transaction
+static void i2c_finish(uint8_t status)
+{
+	i2c_transaction_t *t = queue_head;
 
 	// Send stop and reset I2C block
 	I2C0_C1 = I2C_C1_IICEN;
 
+	queue_head = t->next;
+	if(!queue_head)
+		queue_tail = NULL;
+	i2c_state = STATE_IDLE;
 
-	return err_code;
-}
+	t->status = status;
+	if(t->callback)
+		t->callback(t);
+	event_set(EVENT_I2C);
 
+	// The callback may have queued (and started) another one already
+	if(i2c_state == STATE_IDLE)
+		i2c_start_next();
+}
 
-// Read bytes from slave device
-uint8_t i2c_read(uint8_t slave_address, uint8_t max_bytes, uint8_t *buffer)
+void i2c0_isr(void)
 {
-	uint8_t count = 0;
-	uint8_t dummyread;
+	i2c_transaction_t *t = queue_head;
 	uint8_t stat;
 
-	if(max_bytes > I2C_RD_MAX_BYTES)
+	stat = I2C0_S;
+	I2C0_S = I2C_S_IICIF; // clear flag
+
+	// Stop detected, or set pending by i2c_tick(): see if the bus has
+	// gone idle
+	if(i2c_state == STATE_WAIT_BUS)
 	{
-		i2c_rx_err = I2C_RD_ERR_TOO_MANY_BYTES;
-		return 0;
+		I2C0_FLT = I2C_FLT_FLT(I2C0_FLT) | I2C_FLT_STOPF;
+		i2c_start_next();
+		return;
 	}
 
-	// Clear flags
-	I2C0_S = I2C_S_IICIF | I2C_S_ARBL;
+	if(!t || (i2c_state == STATE_IDLE) || !(stat & I2C_S_IICIF))
+		return;
 
-	// Grab the bus to send the address
-	// If we're already the master, send a rep start,
-	// otherwise, wait for the bus to clear, then send a start
-	if(I2C0_C1 & I2C_C1_MST)
+	// The interrupt flag is set for arb lost and NACKs as well as for
+	// completed transfers
+	if(stat & I2C_S_ARBL)
 	{
-		I2C0_C1 = I2C_C1_IICEN | I2C_C1_MST | I2C_C1_RSTA | I2C_C1_TX;
+		// Clear arb lost flag
+		I2C0_S = I2C_S_ARBL;
+		i2c_finish(I2C_WRT_ERR_LOST_ARB);
+		return;
 	}
-	else
+
+	switch(i2c_state)
 	{
-		while(I2C0_S & I2C_S_BUSY)
-		{
-			yield();
-		}
+		case STATE_ADDR_W:
+			if(stat & I2C_S_RXAK)
+			{
+				i2c_finish(I2C_WRT_ERR_ADDR_NACK);
+				break;
+			}
+			i2c_state = STATE_TX;
+			i2c_idx = 0;
+			I2C0_D = t->tx_buf[i2c_idx++];
+			break;
 
-		I2C0_C1 = I2C_C1_IICEN | I2C_C1_MST | I2C_C1_TX;
-	}
+		case STATE_TX:
+			if(stat & I2C_S_RXAK)
+			{
+				i2c_finish(I2C_WRT_ERR_DATA_NACK);
+			}
+			else if(i2c_idx < t->tx_len)
+			{
+				I2C0_D = t->tx_buf[i2c_idx++];
+			}
+			else if(t->rx_len > 0)
+			{
+				// Repeated start to turn the bus around for the read
+				I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_RSTA | I2C_C1_TX;
+				i2c_state = STATE_ADDR_R;
+				I2C0_D = (t->address << 1) | 1;
+			}
+			else
+			{
+				i2c_finish(I2C_STATUS_OK);
+			}
+			break;
 
-	// Send the address
-	I2C0_D = (slave_address << 1) | 1;
-	
-	// Wait for xfer to complete
-	while(!(I2C0_S & I2C_S_IICIF))
-		yield();
-	I2C0_S = I2C_S_IICIF;
+		case STATE_ADDR_R:
+			if(stat & I2C_S_RXAK)
+			{
+				i2c_finish(I2C_WRT_ERR_ADDR_NACK);
+				break;
+			}
+			if(t->rx_len == 0)
+			{
+				i2c_finish(I2C_STATUS_OK);
+				break;
+			}
+			i2c_state = STATE_RX;
+			i2c_idx = 0;
+
+			// Switch to receive, and NACK the byte if it's the only one
+			if(t->rx_len == 1)
+				I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TXAK;
+			else
+				I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST;
 
-	stat = I2C0_S;
+			// Dummy read clocks in the first byte
+			stat = I2C0_D;
+			break;
 
-	if(stat & I2C_S_RXAK)
-	{
-		I2C0_C1 = I2C_C1_IICEN; // Reset block
-		i2c_rx_err = I2C_RD_ERR_ADDR_NACK;
-		return 0;
+		case STATE_RX:
+			if(i2c_idx == t->rx_len - 1)
+			{
+				// Last byte: switch back to transmit so reading the data
+				// register doesn't start another byte
+				I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TX;
+				t->rx_buf[i2c_idx++] = I2C0_D;
+				i2c_finish(I2C_STATUS_OK);
+			}
+			else
+			{
+				// NACK the next byte if it's the last one
+				if(i2c_idx == t->rx_len - 2)
+					I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TXAK;
+				t->rx_buf[i2c_idx++] = I2C0_D;
+			}
+			break;
 	}
+}
 
-	if(stat & I2C_S_ARBL)
+void i2c_tick(void)
+{
+	// Run the I2C interrupt to retry the start, so only it ever touches
+	// the state machine
+	if(i2c_state == STATE_WAIT_BUS)
 	{
-		I2C0_C1 = I2C_C1_IICEN;
-		i2c_rx_err = I2C_RD_ERR_LOST_ARB;
-		return 0;
+		bus_wait_ticks++;
+		NVIC_SET_PENDING(IRQ_I2C0);
 	}
+}
+
+
+// Run a transaction and wait for it to finish
+static uint8_t i2c_transfer(i2c_transaction_t *t)
+{
+	t->callback = NULL;
+	i2c_submit(t);
+	while(t->status == I2C_STATUS_PENDING)
+		yield();
+	return t->status;
+}
 
-	// Now actually read the bytes in
-	if(max_bytes == 1)
+// Write bytes to slave device
+uint8_t i2c_write(uint8_t slave_address, uint8_t num_bytes, const uint8_t *buffer)
+{
+	i2c_transaction_t t;
+
+	// Check for num_bytes larger than MAX_BYTES
+	if(num_bytes > I2C_WRT_MAX_BYTES)
 	{
-		I2C0_C1 = I2C_C1_IICEN | I2C_C1_MST | I2C_C1_TXAK;
+		return I2C_WRT_ERR_TOO_MANY_BYTES;
 	}
-	else
+
+	t.address = slave_address;
+	t.tx_buf = buffer;
+	t.tx_len = num_bytes;
+	t.rx_buf = NULL;
+	t.rx_len = 0;
+
+	return i2c_transfer(&t);
+}
+
+
+// Read bytes from slave device
+uint8_t i2c_read(uint8_t slave_address, uint8_t max_bytes, uint8_t *buffer)
+{
+	i2c_transaction_t t;
+
+	if(max_bytes > I2C_RD_MAX_BYTES)
 	{
-		I2C0_C1 = I2C_C1_IICEN | I2C_C1_MST;
+		i2c_rx_err = I2C_RD_ERR_TOO_MANY_BYTES;
+		return 0;
 	}
 
-	dummyread = I2C0_D;
+	t.address = slave_address;
+	t.tx_buf = NULL;
+	t.tx_len = 0;
+	t.rx_buf = buffer;
+	t.rx_len = max_bytes;
 
-	while(max_bytes > 1)
+	switch(i2c_transfer(&t))
 	{
-		// wait for data
-		while(!(I2C0_S & I2C_S_IICIF))
-			yield();
-		I2C0_S = I2C_S_IICIF;
+		case I2C_STATUS_OK:
+			i2c_rx_err = 0;
+			return max_bytes;
+		case I2C_WRT_ERR_LOST_ARB:
+			i2c_rx_err = I2C_RD_ERR_LOST_ARB;
+			return 0;
+		default:
+			i2c_rx_err = I2C_RD_ERR_ADDR_NACK;
+			return 0;
+	}
+}
 
-		max_bytes--;
+// Write then read with a repeated start in between, returns 0 or one of
+// the I2C_WRT_ERR codes
+uint8_t i2c_write_read(uint8_t slave_address, uint8_t num_tx, const uint8_t *tx_buffer,
+		uint8_t num_rx, uint8_t *rx_buffer)
+{
+	i2c_transaction_t t;
 
-		if(max_bytes == 1)
-		{
-			I2C0_C1 = I2C_C1_IICEN | I2C_C1_MST | I2C_C1_TXAK;
-		}
-		
-		buffer[count] = I2C0_D;
-		count++;
+	if((num_tx > I2C_WRT_MAX_BYTES) || (num_rx > I2C_RD_MAX_BYTES))
+	{
+		return I2C_WRT_ERR_TOO_MANY_BYTES;
 	}
 
-	while(!(I2C0_S & I2C_S_IICIF))
-		yield();
-	I2C0_S = I2C_S_IICIF;
+	t.address = slave_address;
+	t.tx_buf = tx_buffer;
+	t.tx_len = num_tx;
+	t.rx_buf = rx_buffer;
+	t.rx_len = num_rx;
 
-	I2C0_C1 = I2C_C1_IICEN | I2C_C1_MST | I2C_C1_TX;
-	buffer[count] = I2C0_D;
-	count++;
-	I2C0_C1 = I2C_C1_IICEN;
-	i2c_rx_err = 0;
-	return count;
+	return i2c_transfer(&t);
 }
 
 // Return read error
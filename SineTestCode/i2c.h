@@ -34,6 +34,59 @@
 // Initialize I2C block
 void i2c_init();
 
+// Standard, fast mode and fast mode plus SCL rates
+#define I2C_CLOCK_100K             100000
+#define I2C_CLOCK_400K             400000
+#define I2C_CLOCK_1M               1000000
+
+// Rate set up by i2c_init().  The CS4272 control port is only rated for
+// standard mode, so the faster rates are for other parts on the bus.
+#ifndef I2C_CLOCK
+#define I2C_CLOCK                  I2C_CLOCK_100K
+#endif
+
+// Set the SCL rate to the fastest the divider allows without going over
+// freq (at least F_BUS/3840), waiting for any queued transfers first.
+// Returns the actual rate in Hz.
+uint32_t i2c_set_clock(uint32_t freq);
+
+// A queued transfer: tx_len bytes are written, then (after a repeated
+// start if there was a write) rx_len bytes are read.  The transaction and
+// its buffers belong to the caller and must stay put until status is no
+// longer I2C_STATUS_PENDING.
+typedef struct i2c_transaction_struct
+{
+	uint8_t address;
+	uint8_t tx_len;
+	uint8_t rx_len;
+	const uint8_t *tx_buf;
+	uint8_t *rx_buf;
+
+	// Called from the I2C interrupt when the transfer is done (or NULL)
+	void (*callback)(struct i2c_transaction_struct *t);
+	void *user; // for the callback's use
+
+	// I2C_STATUS_PENDING, I2C_STATUS_OK or an I2C_WRT_ERR code
+	volatile uint8_t status;
+
+	// Queue link, used internally
+	struct i2c_transaction_struct *next;
+} i2c_transaction_t;
+
+#define I2C_STATUS_OK              0
+#define I2C_STATUS_PENDING         0xFF
+
+// Queue a transaction to run in the background, returns 0
+uint8_t i2c_submit(i2c_transaction_t *t);
+
+// Nonzero while any transaction is queued or in progress
+uint8_t i2c_busy();
+
+// Called from the systick interrupt.  A transaction queued right after
+// another one's stop waits for the bus to go idle, normally for the stop
+// detect interrupt.  This retries it in case the stop is never seen.
+void i2c_tick(void);
+
 // Write bytes to slave device, return >0 if error condition
 uint8_t i2c_write(uint8_t slave_address, uint8_t num_bytes, const uint8_t *buffer);
 
@@ -47,6 +100,11 @@ uint8_t i2c_write(uint8_t slave_address, uint8_t num_bytes, const uint8_t *buffe
 // Read bytes from slave, returning the number of bytes received
 uint8_t i2c_read(uint8_t slave_address, uint8_t max_bytes, uint8_t *buffer);
 
+// Write bytes then read bytes back, with a repeated start in between.
+// Returns 0 or one of the write error codes.
+uint8_t i2c_write_read(uint8_t slave_address, uint8_t num_tx, const uint8_t *tx_buffer,
+		uint8_t num_rx, uint8_t *rx_buffer);
+
 // i2c_read can't return an error code, so need to store it off and read
 // it back with a separate function
 uint8_t i2c_get_read_err();
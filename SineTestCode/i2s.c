@@ -55,7 +55,11 @@ void i2s_init()
 	// Bit clock generated externally (slave mode)
 	I2S0_TCR2 = I2S_TCR2_SYNC(0) | I2S_TCR2_BCP;
 
+#if I2S_NUM_LINES > 1
+	I2S0_TCR3 = I2S_TCR3_TCE_2CH; // Enable ch 0 and 1
+#else
 	I2S0_TCR3 = I2S_TCR3_TCE; // Only enable ch 0
+#endif
 
 	// Frame size is 2 (L + R), sync width is 32 (LR clock is active for first word),
 	// MSB first, LR clock asserted with first bit
@@ -83,7 +87,11 @@ void i2s_init()
 	// Same settings as tx, but sync to tx
 	I2S0_RCR2 = I2S_RCR2_SYNC(1) | I2S_TCR2_BCP;
 
+#if I2S_NUM_LINES > 1
+	I2S0_RCR3 = I2S_RCR3_RCE_2CH; // Enable ch 0 and 1
+#else
 	I2S0_RCR3 = I2S_RCR3_RCE; // Enable ch 0
+#endif
 
 	// two words per frame, sync width 16 bit clocks, MSB first, sync early,
 	// LR clock(sync) active low, sync generated internally
@@ -99,6 +107,10 @@ void i2s_init()
 	PORTC_PCR3 = PORT_PCR_MUX(6); // Bit clock
 	PORTC_PCR5 = PORT_PCR_MUX(4); // RX
 	PORTC_PCR6 = PORT_PCR_MUX(6); // MCLK
+#if I2S_NUM_LINES > 1
+	PORTC_PCR0 = PORT_PCR_MUX(6); // TX, second board
+	PORTC_PCR11 = PORT_PCR_MUX(4); // RX, second board
+#endif
 	
 }
 
@@ -128,6 +140,12 @@ void i2s_start()
 	I2S0_TDR0 = 0;
 	I2S0_TDR0 = 0;
 	I2S0_TDR0 = 0;
+#if I2S_NUM_LINES > 1
+	I2S0_TDR1 = 0;
+	I2S0_TDR1 = 0;
+	I2S0_TDR1 = 0;
+	I2S0_TDR1 = 0;
+#endif
 
 
 	// enable IRQs
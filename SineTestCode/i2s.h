@@ -28,6 +28,16 @@
 // William Hollender, 4/28/14
 /////////////////////////////////////////////////////////////////////////////////////////
 
+// Data lines in use, one per board (see NUM_BOARDS in cs4272.h).  Line 0
+// is TXD0/RXD0 on pins 22/13 (PTC1/PTC5), line 1 is TXD1/RXD1 on pins
+// 15/30 (PTC0/PTC11).  Both lines run off the same clocks, so samples on
+// them line up frame for frame.  Each line carries a normal 2 slot frame;
+// the CS4272 doesn't do TDM.
+#ifndef NUM_BOARDS
+#define NUM_BOARDS 1
+#endif
+#define I2S_NUM_LINES NUM_BOARDS
+
 void i2s_init();
 
 void i2s_start();
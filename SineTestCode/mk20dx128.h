@@ -32,15 +32,20 @@
 #define _mk20dx128_h_
 
 //#define F_CPU 96000000
+//#define F_CPU 72000000
 //#define F_CPU 48000000
 //#define F_CPU 24000000
 //#define F_BUS 48000000
+//#define F_BUS 36000000
 //#define F_BUS 24000000
 //#define F_MEM 24000000
 
 #if (F_CPU == 96000000)
  #define F_BUS 48000000
  #define F_MEM 24000000
+#elif (F_CPU == 72000000)
+ #define F_BUS 36000000
+ #define F_MEM 24000000
 #elif (F_CPU == 48000000)
  #define F_BUS 48000000
  #define F_MEM 24000000
@@ -59,6 +64,15 @@
 extern "C" {
 #endif
 
+// Code and data that should be in RAM rather than flash, copied there
+// along with .data by ResetHandler.  Flash needs wait states above 24 MHz,
+// RAM doesn't.  FASTRUN code lands at the start of .data, in SRAM_L, which
+// the core fetches over the code bus.  FASTDATA goes with the rest of
+// the initialized data (don't mix const and non-const FASTDATA in one
+// file, or GCC complains about a section type conflict).
+#define FASTRUN __attribute__ ((section(".fastrun"), noinline, noclone))
+#define FASTDATA __attribute__ ((section(".fastdata")))
+
 // chapter 11: Port control and interrupts (PORT)
 #define PORTA_PCR0		*(volatile uint32_t *)0x40049000 // Pin Control Register n
 #define PORT_PCR_ISF			(uint32_t)0x01000000		// Interrupt Status Flag
@@ -1616,6 +1630,10 @@ typedef struct {
 #define I2C_C2_RMEN			(uint8_t)0x08			// Range Address Matching Enable
 #define I2C_C2_AD(n)			((n) & 7)			// Slave Address, upper 3 bits
 #define I2C0_FLT		*(volatile uint8_t  *)0x40066006 // I2C Programmable Input Glitch Filter register
+#define I2C_FLT_SHEN			(uint8_t)0x80			// Stop Hold Enable (MK20DX256 only)
+#define I2C_FLT_STOPF			(uint8_t)0x40			// Bus Stop Detect Flag (MK20DX256 only)
+#define I2C_FLT_STOPIE			(uint8_t)0x20			// Bus Stop Interrupt Enable (MK20DX256 only)
+#define I2C_FLT_FLT(n)			((uint8_t)((n) & 0x1F))		// Glitch Filter Factor
 #define I2C0_RA			*(volatile uint8_t  *)0x40066007 // I2C Range Address register
 #define I2C0_SMB		*(volatile uint8_t  *)0x40066008 // I2C SMBus Control and Status register
 #define I2C0_A2			*(volatile uint8_t  *)0x40066009 // I2C Address Register 2
@@ -1850,6 +1868,7 @@ typedef struct {
 #define I2S0_TCR3		*(volatile uint32_t *)0x4002F00C // SAI Transmit Configuration 3 Register
 #define I2S_TCR3_WDFL(n)		((uint32_t)n & 0x0f)	      // word flag configuration
 #define I2S_TCR3_TCE			((uint32_t)0x10000)	      // transmit channel enable
+#define I2S_TCR3_TCE_2CH		((uint32_t)0x30000)	      // transmit channel enable, both channels
 #define I2S0_TCR4		*(volatile uint32_t *)0x4002F010 // SAI Transmit Configuration 4 Register
 #define I2S_TCR4_FSD			((uint32_t)1)		      // Frame Sync Direction
 #define I2S_TCR4_FSP			((uint32_t)2)		      // Frame Sync Polarity
@@ -1901,6 +1920,7 @@ typedef struct {
 #define I2S0_RCR3		*(volatile uint32_t *)0x4002F08C // SAI Receive Configuration 3 Register
 #define I2S_RCR3_WDFL(n)		((uint32_t)n & 0x0f)	      // word flag configuration
 #define I2S_RCR3_RCE			((uint32_t)0x10000)	      // receive channel enable
+#define I2S_RCR3_RCE_2CH		((uint32_t)0x30000)	      // receive channel enable, both channels
 #define I2S0_RCR4		*(volatile uint32_t *)0x4002F090 // SAI Receive Configuration 4 Register
 #define I2S_RCR4_FSD			((uint32_t)1)		      // Frame Sync Direction
 #define I2S_RCR4_FSP			((uint32_t)2)		      // Frame Sync Polarity
@@ -2142,6 +2162,55 @@ typedef struct {
 #define __disable_irq() asm volatile("CPSID i");
 #define __enable_irq()	asm volatile("CPSIE i");
 
+// For critical sections that may be entered with interrupts already off
+// (or from an interrupt handler): disable interrupts and return the old
+// PRIMASK, then put it back rather than turning interrupts on.
+static inline uint32_t __save_irq(void) __attribute__((always_inline, unused));
+static inline uint32_t __save_irq(void)
+{
+	uint32_t primask;
+	asm volatile("mrs %0, primask\n\tcpsid i" : "=r" (primask) :: "memory");
+	return primask;
+}
+static inline void __restore_irq(uint32_t primask) __attribute__((always_inline, unused));
+static inline void __restore_irq(uint32_t primask)
+{
+	asm volatile("msr primask, %0" :: "r" (primask) : "memory");
+}
+
+// Exclusive access, ARMv7-M ref manual, A3.4.  The Cortex-M4 local monitor
+// is only cleared by CLREX, STREX and exception entry/return, so a
+// LDREX/STREX pair fails (returns 1) if any interrupt ran in between.
+static inline uint32_t __ldrexw(volatile uint32_t *addr) __attribute__((always_inline, unused));
+static inline uint32_t __ldrexw(volatile uint32_t *addr)
+{
+	uint32_t val;
+	asm volatile("ldrex %0, [%1]" : "=r" (val) : "r" (addr) : "memory");
+	return val;
+}
+static inline uint32_t __strexw(uint32_t val, volatile uint32_t *addr) __attribute__((always_inline, unused));
+static inline uint32_t __strexw(uint32_t val, volatile uint32_t *addr)
+{
+	uint32_t fail;
+	asm volatile("strex %0, %2, [%1]" : "=&r" (fail) : "r" (addr), "r" (val) : "memory");
+	return fail;
+}
+static inline uint16_t __ldrexh(volatile uint16_t *addr) __attribute__((always_inline, unused));
+static inline uint16_t __ldrexh(volatile uint16_t *addr)
+{
+	uint32_t val;
+	asm volatile("ldrexh %0, [%1]" : "=r" (val) : "r" (addr) : "memory");
+	return val;
+}
+static inline uint32_t __strexh(uint16_t val, volatile uint16_t *addr) __attribute__((always_inline, unused));
+static inline uint32_t __strexh(uint16_t val, volatile uint16_t *addr)
+{
+	uint32_t fail;
+	asm volatile("strexh %0, %2, [%1]" : "=&r" (fail) : "r" (addr), "r" ((uint32_t)val) : "memory");
+	return fail;
+}
+#define __clrex() asm volatile("clrex" ::: "memory")
+
 // System Control Space (SCS), ARMv7 ref manual, B3.2, page 708
 #define SCB_CPUID		*(const	   uint32_t *)0xE000ED00 // CPUID Base Register
 #define SCB_ICSR		*(volatile uint32_t *)0xE000ED04 // Interrupt Control and State
@@ -29,6 +29,7 @@
  */
 
 #include "avr_functions.h"
+#include "fmt.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -47,6 +48,11 @@ char * ultoa(unsigned long val, char *buf, int radix)
 	int i=0, j;
 	char t;
 
+	if (radix == 10) {
+		// table driven, no reversal pass
+		buf[fmt_u32(val, buf)] = 0;
+		return buf;
+	}
 	while (1) {
 		digit = val % radix;
 		buf[i] = ((digit < 10) ? '0' + digit : 'A' + digit - 10);
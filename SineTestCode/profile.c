@@ -0,0 +1,104 @@
+/******************************************************************************
+* Sine loopback test for SuperAudioBoard
+*
+* profile.c
+*
+* Cycle count profiling of the interrupt handlers and processing stages.
+*
+* The Cortex-M4 DWT cycle counter counts CPU clocks, so reading it before
+* and after a stage is a single load each way and gives the stage time to
+* the cycle.  Each stage keeps a count, min, max, running total and a
+* histogram, all of which the PROF command sends back to the host.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#include "profile.h"
+
+prof_stage_t prof_stages[PROF_NUM_STAGES];
+
+static const char * const stage_names[PROF_NUM_STAGES] =
+{
+	"i2s_isr",
+	"usb_isr",
+	"audio_frame",
+	"compress",
+	"usb_tx",
+	"usb_irq_off",
+};
+
+void prof_init(void)
+{
+	// The counter is part of the debug blocks, which are off out of reset
+	ARM_DEMCR |= ARM_DEMCR_TRCENA;
+	ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+
+	prof_reset();
+}
+
+void prof_reset(void)
+{
+	uint8_t i, j;
+
+	__disable_irq();
+	for(i = 0; i < PROF_NUM_STAGES; i++)
+	{
+		prof_stages[i].count = 0;
+		prof_stages[i].min = 0xFFFFFFFF;
+		prof_stages[i].max = 0;
+		prof_stages[i].total = 0;
+		for(j = 0; j < PROF_HIST_BINS; j++)
+			prof_stages[i].hist[j] = 0;
+	}
+	__enable_irq();
+}
+
+const char *prof_stage_name(uint8_t stage)
+{
+	if(stage >= PROF_NUM_STAGES)
+		return "?";
+	return stage_names[stage];
+}
+
+#ifndef NO_PROFILE
+
+void prof_end(uint8_t stage, uint32_t start)
+{
+	// Unsigned subtract handles the counter wrapping
+	uint32_t cycles = ARM_DWT_CYCCNT - start;
+	prof_stage_t *s = &prof_stages[stage];
+	uint32_t bin;
+
+	s->count++;
+	s->total += cycles;
+	if(cycles < s->min)
+		s->min = cycles;
+	if(cycles > s->max)
+		s->max = cycles;
+
+	// Constant divide, so this is a multiply
+	bin = cycles / PROF_HIST_WIDTH;
+	if(bin >= PROF_HIST_BINS)
+		bin = PROF_HIST_BINS - 1;
+	s->hist[bin]++;
+}
+
+#endif
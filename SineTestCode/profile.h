@@ -0,0 +1,110 @@
+/******************************************************************************
+* Sine loopback test for SuperAudioBoard
+*
+* profile.h
+*
+* Cycle count profiling of the interrupt handlers and processing stages.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <inttypes.h>
+#include "mk20dx128.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Profiled stages.  The I2S handler time includes usb_audio_i2s_frame(),
+// and any stage can be stretched by a higher priority interrupt landing
+// in the middle of it.
+#define PROF_I2S_ISR      0  // i2s0_tx_isr(), once per frame
+#define PROF_USB_ISR      1  // usb_isr()
+#define PROF_AUDIO_FRAME  2  // usb_audio_i2s_frame(), USB audio buffering
+#define PROF_COMPRESS     3  // compress_frame(), one block for GET RICE
+#define PROF_USB_TX       4  // usb_tx_multi(), queueing a batch of serial packets
+#define PROF_USB_IRQ_OFF  5  // usb_rx_memory(), the one section of the USB code
+                             // that still masks interrupts
+#define PROF_NUM_STAGES   6
+
+// Length of one sample period at 48kHz in CPU cycles
+#define PROF_SAMPLE_CYCLES  (F_CPU / 48000)
+
+// Histogram of stage times, PROF_HIST_BINS bins each an eighth of a sample
+// period wide, so the first 8 bins are everything that fits in one period.
+// Anything over two periods goes in the last bin.
+#define PROF_HIST_BINS      16
+#define PROF_HIST_WIDTH     (PROF_SAMPLE_CYCLES / 8)
+
+typedef struct
+{
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;
+	uint32_t hist[PROF_HIST_BINS];
+} prof_stage_t;
+
+extern prof_stage_t prof_stages[PROF_NUM_STAGES];
+
+// Turn on the DWT cycle counter and clear the statistics
+void prof_init(void);
+
+// Clear the statistics
+void prof_reset(void);
+
+// Name of a stage for printing
+const char *prof_stage_name(uint8_t stage);
+
+#ifndef NO_PROFILE
+
+// Bracket a stage with these:
+//
+//	uint32_t start = prof_start();
+//	...
+//	prof_end(PROF_I2S_ISR, start);
+//
+// Each stage should only be measured from one context (one interrupt, or
+// the main loop), there's no locking.
+static inline uint32_t prof_start(void) __attribute__((always_inline, unused));
+static inline uint32_t prof_start(void)
+{
+	return ARM_DWT_CYCCNT;
+}
+
+void prof_end(uint8_t stage, uint32_t start);
+
+#else
+
+// Build with NO_PROFILE to take the measurements out altogether
+#define prof_start()        0
+#define prof_end(stage, start)  ((void)(start))
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,97 @@
+/******************************************************************************
+* Sine loopback test for SuperAudioBoard
+*
+* sched.c
+*
+* Cooperative background jobs, run from yield() whenever the main loop is
+* waiting on something.
+*
+* This replaces the empty weak yield() in yield.c.  Jobs run to completion
+* one after another, so they never interrupt each other or the code that
+* called yield().  A job that waits on something itself (an I2C
+* transfer, say) ends up back in yield(); that nested call just sleeps
+* rather than running the jobs again.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#include "mk20dx128.h"
+#include "sched.h"
+#include "event.h"
+
+static sched_job_t jobs[SCHED_MAX_JOBS];
+static uint8_t num_jobs = 0;
+static uint8_t in_yield = 0;
+
+uint8_t sched_add(sched_job_t job)
+{
+	uint8_t i;
+
+	for(i = 0; i < num_jobs; i++)
+	{
+		if(jobs[i] == job)
+			return 0;
+	}
+
+	if(num_jobs >= SCHED_MAX_JOBS)
+		return 1;
+
+	jobs[num_jobs++] = job;
+	return 0;
+}
+
+void sched_remove(sched_job_t job)
+{
+	uint8_t i;
+
+	for(i = 0; i < num_jobs; i++)
+	{
+		if(jobs[i] == job)
+		{
+			// Keep the rest in order
+			num_jobs--;
+			for(; i < num_jobs; i++)
+				jobs[i] = jobs[i + 1];
+			return;
+		}
+	}
+}
+
+void yield(void)
+{
+	uint8_t i, more = 0;
+
+	if(in_yield)
+	{
+		event_idle();
+		return;
+	}
+
+	in_yield = 1;
+	for(i = 0; i < num_jobs; i++)
+		more |= jobs[i]();
+	in_yield = 0;
+
+	// Whatever we're waiting on is flagged by an interrupt, and so is
+	// anything that would give a job more to do
+	if(!more)
+		event_idle();
+}
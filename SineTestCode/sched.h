@@ -0,0 +1,62 @@
+/******************************************************************************
+* Sine loopback test for SuperAudioBoard
+*
+* sched.h
+*
+* Cooperative background jobs, run from yield() whenever the main loop is
+* waiting on something.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCHED_MAX_JOBS  4
+
+// A background job does a short, bounded piece of work and returns.
+// Return nonzero if there's more to do straight away, 0 to let the CPU
+// sleep until the next interrupt.
+typedef uint8_t (*sched_job_t)(void);
+
+// Add a job to the list run by yield().  Returns 0, or 1 if the list is
+// full.  Adding a job that's already there does nothing.
+uint8_t sched_add(sched_job_t job);
+
+// Take a job off the list
+void sched_remove(sched_job_t job);
+
+// Run every job once, then sleep if none of them have more to do.
+// Everything that waits (delay(), I2C, USB writes and reads) calls this.
+// Only call it from the main loop, never from an interrupt.
+void yield(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
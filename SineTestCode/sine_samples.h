@@ -8,7 +8,7 @@
 
 
 #define SIG_LENGTH 48
-const int32_t out_buf[SIG_LENGTH] = {0,975860,1935023,2861077,3738177,4551316,5286581,5931390,6474712,6907250,7221603,7412393,7476354,7412393,7221603,6907250,
+const int32_t out_buf[SIG_LENGTH] FASTDATA = {0,975860,1935023,2861077,3738177,4551316,5286581,5931390,6474712,6907250,7221603,7412393,7476354,7412393,7221603,6907250,
                                6474712,5931390,5286581,4551316,3738177,2861077,1935023,975860,0,-975860,-1935023,-2861077,-3738177,-4551316,-5286581,-5931390,
                                -6474712,-6907250,-7221603,-7412393,-7476354,-7412393,-7221603,-6907250,-6474712,-5931390,-5286581,-4551316,-3738177,-2861077,-1935023,-975860
                                };
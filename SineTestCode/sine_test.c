@@ -26,21 +26,71 @@
 #include "usb_dev.h"
 #include "core_pins.h"
 #include <string.h>
+#include <stdlib.h>
 #include "i2c.h"
 #include "cs4272.h"
 #include "avr_functions.h"
 #include "i2s.h"
 #include "delay.h"
 #include "sine_samples.h"
+#include "usb_audio.h"
+#include "fmt.h"
+#include "compress.h"
+#include "profile.h"
+#include "event.h"
+#include "sched.h"
 
 #define NUM_AVGS 1024
 
 #define NUM_SAMP 4080
 
-#define NUM_RUNS 256
+// Default (and maximum) number of runs summed per test.  The sums are
+// kept in int32_t, so 255 runs of 24 bit samples is as far as it goes.
+#define NUM_RUNS 255
+
+// Output channel selection for test_channel
+#define TEST_CH_LEFT	0x01
+#define TEST_CH_RIGHT	0x02
+
+#define CMD_LINE_LEN 64
+
+// INIT waits for the ADC high pass filter to take out the input DC
+// offset.  The ISR averages blocks of SETTLE_BLOCK_LEN frames, and once
+// the block averages on both channels have moved by no more than
+// SETTLE_DC_STEP (24 bit counts) for SETTLE_BLOCKS blocks in a row the
+// filter is considered settled.  With the filter's ~3.7Hz corner that's
+// normally well under a second.  SETTLE_TIMEOUT_MS is the old fixed wait,
+// so a board that never settles is no worse off than before.
+#define SETTLE_BLOCK_SHIFT	10
+#define SETTLE_BLOCK_LEN	(1 << SETTLE_BLOCK_SHIFT)
+#define SETTLE_BLOCKS		4
+#define SETTLE_DC_STEP		32
+#define SETTLE_TIMEOUT_MS	10000
+
+// Longest a binary GET waits for the right channel to go out before
+// queueing the left, well past the ~20ms it takes a listening host
+#define GET_DRAIN_TIMEOUT_MS	1000
+
+// The codec drives the I2S clocks, so no frames within this long after
+// setting it up means it didn't start
+#define LOCK_TIMEOUT_MS		100
+
+// One detector per ADC input: left and right of each board
+#define SETTLE_CHANNELS		(2 * NUM_BOARDS)
+
+// settle_state values
+#define SETTLE_OFF		0
+#define SETTLE_RUNNING	1
+#define SETTLE_DONE		2
 
 uint8_t serial_read_line(char* buf, uint8_t max_len);
-void serial_write_string(const char *str);
+
+static void process_command(char *line);
+static void reply(const char *str);
+static void reply_ok_u32(uint32_t val);
+static uint8_t parse_u32(char **str, uint32_t *val);
+static char *next_token(char **str);
+static void settle_frame(const int32_t *samples);
 
 volatile uint16_t tx_buf_idx;
 volatile uint16_t rx_buf_idx;
@@ -53,15 +103,72 @@ volatile int32_t recv_data_right[NUM_SAMP];
 volatile int32_t recv_data_left[NUM_SAMP];
 
 volatile uint8_t test_running = 0;
+
+// micros64() time stamps of the first and last summed frames of a test
+volatile uint64_t capture_start, capture_end;
 //volatile uint8_t output_real_part = 1;
 
+// Test configuration, set with the CFG command
+volatile uint16_t num_runs = NUM_RUNS;
+volatile uint8_t test_channel = TEST_CH_RIGHT;
+volatile uint8_t test_board = 0;
+
+// DC settle detector state, see settle_frame()
+volatile uint8_t settle_state = SETTLE_OFF;
+volatile uint32_t settle_frames;
+static int64_t settle_sum[SETTLE_CHANNELS];
+static int32_t settle_prev[SETTLE_CHANNELS];
+static uint8_t settle_count;
 
-char buffer[64];
+uint8_t codec_initialized = 0;
+uint8_t data_valid = 0;
+
+char buffer[CMD_LINE_LEN + 1];
+
+// One compressed frame at a time for GET RICE
+static uint8_t frame_buf[COMPRESS_FRAME_MAX(COMPRESS_BLOCK_LEN)];
+
+// Command protocol
+//
+// The host sends one command per line and gets exactly one reply line
+// back, "OK ..." or "ERR <reason>", so a script can drive tests
+// back to back without anybody typing at a prompt.  Numbers can be
+// decimal or 0x hex.
+//
+// INIT             Set up the codec and I2S and wait for the ADC high
+//                  pass filter to settle, OK <ms until valid samples>
+// CFG RUNS <n>     Runs summed per test, 1 to 255
+// CFG CH <L|R|B>   Output the sine on the left, right or both channels
+// CFG BOARD <n>    With more than one board (NUM_BOARDS), the board that
+//                  RUN captures and the register commands talk to.  The
+//                  sine goes out on every board.
+// RUN              Run a test and wait for it to finish, OK <ms> <us>,
+//                  where us is the time from the first summed sample to
+//                  the last going by the sample time stamps
+// GET              OK <bytes>, followed by that many bytes of binary
+//                  data: the right channel sums, then the left, as
+//                  little endian int32_t
+// GET CSV          OK <lines>, followed by "right,left" text lines
+// GET RICE         OK <samples>, followed by the same data as GET,
+//                  losslessly compressed (see compress.h)
+// RR <reg>         Read a codec register (from the shadow copy), OK <value>
+// RW <reg> <val>   Write a codec register
+// VOL <l> <r>      Set the DAC attenuation in dB (0 to 127) for the left
+//                  and right outputs.  Replies straight away, the change
+//                  ramps in on the codec while audio keeps running.
+// MUTE <0|1>       Unmute or mute both DAC outputs, same as VOL
+// RD               Read all the codec registers from the chip in one go,
+//                  OK <reg 1> <reg 2> ... <reg 8>
+// PROF             OK <stages> <cycles per sample>, followed by a line per
+//                  stage: <name> <count> <min> <mean> <max> and the
+//                  PROF_HIST_BINS histogram counts (see profile.h), all
+//                  in CPU cycles since the last PROF RESET
+// PROF RESET       Clear the profiling statistics
+// STAT             OK <initialized> <data valid> <runs> <channel>
+//                  <samples> <board>
 
 int main(void)
 {
-	uint16_t i;
-	char temp_char;
 	uint8_t num_chars_ret;
 
 	// For CS4272 (uC i2s interface in slave mode) not sure about
@@ -69,238 +176,623 @@ int main(void)
 	// For now, start with codec (get interface clocks started first)
 
 
-	// Initialize USB
+	// Initialize USB.  Nothing to wait for, the command loop just sits
+	// there until the host has enumerated us and sends something.
     usb_init();
-	delay(100);
+
+	// Cycle counter for PROF
+	prof_init();
 
 	// Initialize I2C subsystem
 	i2c_init();
-    delay(100);
-
 
+	// Background work, run while the command loop waits on the host
+	sched_add(codec_poll);
 
-	for(i = 0; i < 64; i++)
-	{
-		buffer[i] = 0;
-	}
-	
-	// Wait to setup codec to make sure user has turned on audio board power
-	while((buffer[0] != 'y') && (buffer[0] != 'Y'))
+	// The codec isn't touched until the host sends INIT, which also
+	// gives the user time to turn on the audio board power
+	while(1)
 	{
-		serial_write_string("Init codec? (y/n)\r\n>");
-		
-		// Wait for response
-		num_chars_ret = serial_read_line(buffer,64);
+		num_chars_ret = serial_read_line(buffer, CMD_LINE_LEN);
 
+		// Ignore the empty line between a '\r' and '\n'
 		if(num_chars_ret < 1)
-		{
-			serial_write_string("Error reading line. Please try again.\r\n");
-		}
-	}
+			continue;
 
-	for(i = 0; i < 64; i++)
-	{
-		buffer[i] = 0;
+		buffer[num_chars_ret] = '\0';
+		process_command(buffer);
 	}
 
-	// Initialize CS4272
-	codec_init();
-	delay(100);
+	return 0;
+}
 
+static void cmd_init(void)
+{
+	uint32_t start = millis();
 
+	// Initialize CS4272
+	if(codec_init())
+	{
+		reply("ERR codec not responding");
+		return;
+	}
+	codec_select(test_board);
 
 	// Initialize I2S subsystem 
 	i2s_init();
-	delay(10);
 
-	serial_write_string("Codec Initialized\r\n");
-	delay(10);
+	// Run the interface with the outputs at zero and let the ISR watch
+	// the ADC data for the high pass filter to settle
+	settle_frames = 0;
+	memset(settle_sum, 0, sizeof(settle_sum));
+	settle_count = 0;
+	event_clear(EVENT_SETTLE);
+	settle_state = SETTLE_RUNNING;
+	i2s_start();
+
+	// Frames only come in once the codec has powered up and is driving
+	// the clocks.  The ISR flags the first one, and again once settled.
+	if(!event_wait(EVENT_SETTLE, LOCK_TIMEOUT_MS))
+	{
+		i2s_stop();
+		settle_state = SETTLE_OFF;
+		reply("ERR no I2S clock");
+		return;
+	}
 
+	while((settle_state == SETTLE_RUNNING) && ((millis() - start) < SETTLE_TIMEOUT_MS))
+		event_wait(EVENT_SETTLE, SETTLE_TIMEOUT_MS - (millis() - start));
 
-	// Test to see if i2c is working
-	uint8_t reg_result;
-	uint8_t ii;
-	for(ii = 1; ii < 9; ii++)
-	{
-		itoa(ii,buffer,10);
-		serial_write_string("Address ");
-		serial_write_string(buffer);
-		serial_write_string(": ");
+#ifndef AUDIO_INTERFACE
+	i2s_stop();
+#endif
+	// With AUDIO_INTERFACE the I2S interface stays running from here on,
+	// so the board works as a USB sound card whenever a test isn't running
+	settle_state = SETTLE_OFF;
 
+	codec_initialized = 1;
+	reply_ok_u32(millis() - start);
+}
 
-		reg_result = codec_read(ii);
-		itoa(reg_result,buffer,10);
-		serial_write_string(buffer);
-		serial_write_string("\r\n");
-		delay(100);
-	}
+static void cmd_run(void)
+{
+	char line[3 + 2*FMT_I32_MAX_LEN + 2];
+	char *p;
+	uint16_t i;
+	uint32_t start;
+
+	// A binary GET may still be sending straight out of the sample
+	// buffers, so let it finish before they're cleared
+	while(usb_serial_write_nocopy_busy())
+		yield();
+
+	// Initialize indices, etc
+	tx_buf_idx = 0;
+	rx_buf_idx = 0;
+	curr_run = 0;
 
-	for(i = 0; i < 64; i++)
+	for(i = 0; i < NUM_SAMP; i++)
 	{
-		buffer[i] = 0;
+		recv_data_right[i] = 0;
+		recv_data_left[i] = 0;
 	}
 
-	serial_write_string("Waiting 10 seconds for ADC high pass filter to stabilize\r\n");
-	delay(10000);
-	
-	while(1)
+	start = millis();
+	event_clear(EVENT_TEST);
+	test_running = 1;
+#ifndef AUDIO_INTERFACE
+	i2s_start();
+#endif
+
+	// Sleep until the ISR has finished all the runs
+	while(test_running)
+		event_wait(EVENT_TEST, 0);
+
+	data_valid = 1;
+
+	memcpy(line, "OK ", 3);
+	p = line + 3;
+	p += fmt_u32(millis() - start, p);
+	*p++ = ' ';
+	p += fmt_u32(capture_end - capture_start, p);
+	*p = '\0';
+	reply(line);
+}
+
+static void cmd_get(char *args)
+{
+	char *tok = next_token(&args);
+	uint32_t len, i, n, start;
+
+	if(!data_valid)
 	{
-		
-		// Initialize indices, etc
-		tx_buf_idx = 0;
-		rx_buf_idx = 0;
-		curr_run = 0;
+		reply("ERR no data");
+		return;
+	}
 
-		for(i = 0; i < NUM_SAMP; i++)
+	// Test is stopped, so the ISR is no longer touching the buffers
+	// and it's safe to drop the volatile qualifier.
+	if(tok && (strcmp(tok, "CSV") == 0))
+	{
+		reply_ok_u32(NUM_SAMP);
+		// Only full packets go out during the dump, the last partial
+		// one is sent at the end
+		usb_serial_flush_mode(USB_FLUSH_THRESHOLD, 0);
+		usb_serial_write_csv((const int32_t *)recv_data_right,
+				(const int32_t *)recv_data_left, NUM_SAMP);
+		usb_serial_flush_mode(USB_FLUSH_TIMER, 0);
+		usb_serial_end_message();
+	}
+	else if(tok && (strcmp(tok, "RICE") == 0))
+	{
+		reply_ok_u32(NUM_SAMP);
+		// Compress a block at a time, right channel first like GET
+		usb_serial_flush_mode(USB_FLUSH_THRESHOLD, 0);
+		for(i = 0; i < NUM_SAMP; i += n)
 		{
-			//recv_data_real[i] = 0;
-			//recv_data_imag[i] = 0;
-			recv_data_right[i] = 0;
-			//recv_data_left[i] = 0;
+			n = ((NUM_SAMP - i) < COMPRESS_BLOCK_LEN) ? (NUM_SAMP - i) : COMPRESS_BLOCK_LEN;
+			start = prof_start();
+			len = compress_frame((const int32_t *)recv_data_right + i,
+					(const int32_t *)recv_data_left + i, n, frame_buf);
+			prof_end(PROF_COMPRESS, start);
+			usb_serial_write(frame_buf, len);
 		}
+		len = compress_end(frame_buf);
+		usb_serial_write(frame_buf, len);
+		usb_serial_flush_mode(USB_FLUSH_TIMER, 0);
+		usb_serial_end_message();
+	}
+	else if(!tok)
+	{
+		// Send the sums straight from the sample buffers instead of
+		// copying them through packet memory
+		len = NUM_SAMP * sizeof(int32_t);
+		reply_ok_u32(2 * len);
+		// If a channel doesn't go out the host has stopped reading or
+		// gone away, and it times out on the missing bytes.  Don't
+		// queue the left channel behind a right one that failed.
+		if(usb_serial_write_nocopy((const void *)recv_data_right, len, NULL))
+			return;
+		start = millis();
+		while(usb_serial_write_nocopy_busy() && usb_configuration
+				&& !usb_tx_timed_out(start, GET_DRAIN_TIMEOUT_MS))
+			yield();
+		usb_serial_write_nocopy((const void *)recv_data_left, len, NULL);
+	}
+	else
+	{
+		reply("ERR bad format");
+	}
+}
 
+static void cmd_cfg(char *args)
+{
+	char *tok = next_token(&args);
+	uint32_t val;
 
-
-		for(i = 0; i < 64; i++)
+	if(tok && (strcmp(tok, "RUNS") == 0))
+	{
+		if(!parse_u32(&args, &val) || (val < 1) || (val > NUM_RUNS))
 		{
-			buffer[i] = 0;
+			reply("ERR bad value");
+			return;
 		}
-
-
-		while((buffer[0] != 'y') && (buffer[0] != 'Y'))
+		num_runs = val;
+	}
+	else if(tok && (strcmp(tok, "CH") == 0))
+	{
+		tok = next_token(&args);
+		if(tok && (strcmp(tok, "L") == 0))
+			test_channel = TEST_CH_LEFT;
+		else if(tok && (strcmp(tok, "R") == 0))
+			test_channel = TEST_CH_RIGHT;
+		else if(tok && (strcmp(tok, "B") == 0))
+			test_channel = TEST_CH_LEFT | TEST_CH_RIGHT;
+		else
 		{
-			serial_write_string("Start test? (y/n)\r\n>");
-			
-			// Wait for response
-			num_chars_ret = serial_read_line(buffer,64);
-
-			if(num_chars_ret < 1)
-			{
-				serial_write_string("Error reading line. Please try again.\r\n");
-			}
+			reply("ERR bad value");
+			return;
 		}
-
-		// Start test
-		serial_write_string("Starting test.\r\n");
-		//output_real_part = 1;
-		test_running = 1;
-		i2s_start();
-
-		// Wait for real part to finish
-		while(test_running)
+	}
+	else if(tok && (strcmp(tok, "BOARD") == 0))
+	{
+		if(!parse_u32(&args, &val) || (val >= NUM_BOARDS))
 		{
-			//serial_write_string("Running real part.  Please wait .....\r\n");
-			delay(1000);
+			reply("ERR bad value");
+			return;
 		}
+		test_board = val;
+		codec_select(val);
+	}
+	else
+	{
+		reply("ERR bad setting");
+		return;
+	}
 
-		// Test is now finished
-//		serial_write_string("Real part is finished.  Starting imaginary part.\r\n");
-//		
-//		delay(1000);
-//
-//		// Start imaginary part
-//		output_real_part = 0;
-//		test_running = 1;
-//		i2s_start();
-//
-//		// Wait for real part to finish
-//		while(test_running)
-//		{
-//			//serial_write_string("Running imaginary part.  Please wait .....\r\n");
-//			delay(1000);
-//		}
-//
-//		// Test is now finished
-//		serial_write_string("Imaginary part is finished.  Printing Data.\r\n");
+	// New settings make the old results meaningless
+	data_valid = 0;
+	reply("OK");
+}
+
+static void cmd_stat(void)
+{
+	char line[64];
+	char *p = line;
+
+	memcpy(p, "OK ", 3);
+	p += 3;
+	*p++ = '0' + codec_initialized;
+	*p++ = ' ';
+	*p++ = '0' + data_valid;
+	*p++ = ' ';
+	p += fmt_u32(num_runs, p);
+	*p++ = ' ';
+	*p++ = (test_channel == TEST_CH_LEFT) ? 'L' :
+		((test_channel == TEST_CH_RIGHT) ? 'R' : 'B');
+	*p++ = ' ';
+	p += fmt_u32(NUM_SAMP, p);
+	*p++ = ' ';
+	p += fmt_u32(test_board, p);
+	*p = '\0';
+	reply(line);
+}
+
+static void cmd_prof(char *args)
+{
+	char *tok = next_token(&args);
+	// Name plus 4 + PROF_HIST_BINS numbers
+	char line[16 + (4 + PROF_HIST_BINS)*(FMT_I32_MAX_LEN + 1) + 2];
+	prof_stage_t s;
+	char *p;
+	const char *name;
+	uint8_t i, j;
+
+	if(tok && (strcmp(tok, "RESET") == 0))
+	{
+		prof_reset();
+		reply("OK");
+		return;
+	}
+	else if(tok)
+	{
+		reply("ERR bad option");
+		return;
+	}
+
+	p = line;
+	memcpy(p, "OK ", 3);
+	p += 3;
+	p += fmt_u32(PROF_NUM_STAGES, p);
+	*p++ = ' ';
+	p += fmt_u32(PROF_SAMPLE_CYCLES, p);
+	*p = '\0';
+	reply(line);
 
-		// Print data
-		for(i = 0; i < NUM_SAMP; i++)
+	for(i = 0; i < PROF_NUM_STAGES; i++)
+	{
+		// Snapshot, the interrupts keep updating the live copy
+		__disable_irq();
+		s = prof_stages[i];
+		__enable_irq();
+		if(s.count == 0)
+			s.min = 0;
+
+		name = prof_stage_name(i);
+		p = line;
+		memcpy(p, name, strlen(name));
+		p += strlen(name);
+		*p++ = ' ';
+		p += fmt_u32(s.count, p);
+		*p++ = ' ';
+		p += fmt_u32(s.min, p);
+		*p++ = ' ';
+		p += fmt_u32(s.count ? (uint32_t)(s.total / s.count) : 0, p);
+		*p++ = ' ';
+		p += fmt_u32(s.max, p);
+		for(j = 0; j < PROF_HIST_BINS; j++)
 		{
-			itoa(recv_data_right[i],buffer,10);
-			serial_write_string(buffer);
-			serial_write_string(",");
-			itoa(recv_data_left[i],buffer,10);
-			serial_write_string(buffer);
-			serial_write_string("\r\n");
-			delay(50);
+			*p++ = ' ';
+			p += fmt_u32(s.hist[j], p);
 		}
+		*p++ = '\r';
+		*p++ = '\n';
+		usb_serial_write(line, p - line);
+	}
+	usb_serial_end_message();
+}
 
-		serial_write_string("End of data.\r\n");
-		
+static void cmd_dump(void)
+{
+	uint8_t regs[CODEC_NUM_REGS];
+	char line[3 + 4*CODEC_NUM_REGS + 1];
+	char *p = line + 2;
+	uint8_t i;
+
+	if(codec_read_all(regs))
+	{
+		reply("ERR i2c");
+		return;
 	}
 
-	return 0;
+	memcpy(line, "OK", 2);
+	for(i = 0; i < CODEC_NUM_REGS; i++)
+	{
+		*p++ = ' ';
+		p += fmt_u32(regs[i], p);
+	}
+	*p = '\0';
+	reply(line);
 }
 
-uint8_t serial_read_line(char* buf, uint8_t max_len)
+static void process_command(char *line)
 {
-	int ret;
-	uint8_t num_chars = 0;
-	//char out_buffer[32];
+	char *cmd = next_token(&line);
+	uint32_t reg, val;
 
-	while(num_chars < max_len)
+	if(!cmd)
+	{
+		reply("ERR empty");
+	}
+	else if(strcmp(cmd, "STAT") == 0)
+	{
+		cmd_stat();
+	}
+	else if(strcmp(cmd, "PROF") == 0)
+	{
+		cmd_prof(line);
+	}
+	else if(strcmp(cmd, "INIT") == 0)
+	{
+		cmd_init();
+	}
+	else if(strcmp(cmd, "CFG") == 0)
+	{
+		cmd_cfg(line);
+	}
+	else if(!codec_initialized)
+	{
+		// Everything else talks to the codec
+		reply("ERR not initialized");
+	}
+	else if(strcmp(cmd, "RUN") == 0)
 	{
-		ret = usb_serial_getchar();
-		if(ret == -1)
+		cmd_run();
+	}
+	else if(strcmp(cmd, "GET") == 0)
+	{
+		cmd_get(line);
+	}
+	else if(strcmp(cmd, "RR") == 0)
+	{
+		if(!parse_u32(&line, &reg) || (reg < 1) || (reg > CODEC_CHIP_ID))
+			reply("ERR bad register");
+		else
+			reply_ok_u32(codec_read(reg));
+	}
+	else if(strcmp(cmd, "RD") == 0)
+	{
+		cmd_dump();
+	}
+	else if(strcmp(cmd, "VOL") == 0)
+	{
+		if(!parse_u32(&line, &reg) || (reg > CODEC_ATTEN_MAX)
+				|| !parse_u32(&line, &val) || (val > CODEC_ATTEN_MAX))
+			reply("ERR bad value");
+		else
 		{
-			//strcpy(out_buffer,"getchar returns -1\r\n");
-			//usb_serial_write(out_buffer, strlen(out_buffer));
-			//yield();
-
+			codec_set_volume(reg, val);
+			reply("OK");
 		}
+	}
+	else if(strcmp(cmd, "MUTE") == 0)
+	{
+		if(!parse_u32(&line, &val) || (val > 1))
+			reply("ERR bad value");
+		else
+		{
+			codec_set_mute(val);
+			reply("OK");
+		}
+	}
+	else if(strcmp(cmd, "RW") == 0)
+	{
+		if(!parse_u32(&line, &reg) || (reg < 1) || (reg >= CODEC_CHIP_ID))
+			reply("ERR bad register");
+		else if(!parse_u32(&line, &val) || (val > 0xFF))
+			reply("ERR bad value");
 		else
 		{
-			if(ret == '\r' || ret == '\n')
-			{
-				// We've read the whole line so return
-				//strcpy(out_buffer, "found EOL, returning\r\n");
-				//usb_serial_write(out_buffer,strlen(out_buffer));
-
-				return num_chars;
-			}
-			else
-			{
-				//strcpy(out_buffer, "Got character: ");
-				//usb_serial_write(out_buffer,strlen(out_buffer));
-
-				//usb_serial_putchar(ret);
-				//usb_serial_putchar('\r');
-				//usb_serial_putchar('\n');
-
-				buf[num_chars] = ret;
-				num_chars++;
-			}
+			codec_write(reg, val);
+			reply("OK");
 		}
 	}
+	else
+	{
+		reply("ERR unknown command");
+	}
+}
 
-	return num_chars;
+// Split off the next space separated word, or NULL if there isn't one
+static char *next_token(char **str)
+{
+	char *p = *str;
+	char *tok;
+
+	while(*p == ' ')
+		p++;
+	if(*p == '\0')
+		return NULL;
+
+	tok = p;
+	while((*p != ' ') && (*p != '\0'))
+		p++;
+	if(*p == ' ')
+		*p++ = '\0';
+	*str = p;
+
+	return tok;
+}
+
+// Parse the next word as a decimal or 0x hex number.  Returns 0 if
+// it's missing or isn't a number.
+static uint8_t parse_u32(char **str, uint32_t *val)
+{
+	char *tok = next_token(str);
+	char *end;
+
+	if(!tok)
+		return 0;
+	*val = strtoul(tok, &end, 0);
+	return (*end == '\0');
+}
+
+static void reply(const char *str)
+{
+	usb_serial_write(str, strlen(str));
+	usb_serial_write("\r\n", 2);
+	// Replies are whole messages, don't wait for the flush timer
+	usb_serial_end_message();
+}
+
+static void reply_ok_u32(uint32_t val)
+{
+	char line[3 + FMT_I32_MAX_LEN + 1];
+
+	memcpy(line, "OK ", 3);
+	line[3 + fmt_u32(val, line + 3)] = '\0';
+	reply(line);
 }
 
-void serial_write_string(const char *str)
+uint8_t serial_read_line(char* buf, uint8_t max_len)
 {
-	usb_serial_write(str,strlen(str));
+	// Scans whole packets for the end of line rather than pulling
+	// characters out one at a time with usb_serial_getchar()
+	return usb_serial_readline(buf, max_len);
 }
 
 
-void i2s0_tx_isr(void)
+// Called from the ISR for every frame while INIT is waiting, with the
+// left and right samples of each board.  The high pass filter takes the
+// DC offset out exponentially, so once the block averages stop moving the
+// input is as settled as it's going to get.
+FASTRUN static void settle_frame(const int32_t *samples)
+{
+	int32_t mean;
+	uint8_t ch, still = 1;
+
+	for(ch = 0; ch < SETTLE_CHANNELS; ch++)
+		settle_sum[ch] += samples[ch];
+	settle_frames++;
+	if(settle_frames == 1)
+		event_set(EVENT_SETTLE);
+
+	if(settle_frames & (SETTLE_BLOCK_LEN - 1))
+		return;
+
+	for(ch = 0; ch < SETTLE_CHANNELS; ch++)
+	{
+		mean = settle_sum[ch] >> SETTLE_BLOCK_SHIFT;
+		settle_sum[ch] = 0;
+		if(abs(mean - settle_prev[ch]) > SETTLE_DC_STEP)
+			still = 0;
+		settle_prev[ch] = mean;
+	}
+
+	// Nothing to compare the first block against
+	if(still && (settle_frames > SETTLE_BLOCK_LEN))
+		settle_count++;
+	else
+		settle_count = 0;
+
+	if(settle_count >= SETTLE_BLOCKS)
+	{
+		settle_state = SETTLE_DONE;
+		event_set(EVENT_SETTLE);
+	}
+}
+
+// Everything the I2S interrupt does for one frame.  This and the handler
+// run from RAM, see FASTRUN in mk20dx128.h.
+FASTRUN static void i2s_frame(void)
 {
 	int32_t res, dummy_var;
+#if NUM_BOARDS > 1
+	int32_t left1, right1;
+#endif
+
+	if(settle_state != SETTLE_OFF)
+	{
+		// INIT is waiting on the ADC, keep the outputs quiet.  Once
+		// it's settled just idle until INIT turns the detector off.
+		int32_t in[SETTLE_CHANNELS];
+		uint8_t ch;
+
+		in[0] = I2S0_RDR0; // Left
+		in[1] = I2S0_RDR0; // Right
+		I2S0_TDR0 = 0;
+		I2S0_TDR0 = 0;
+#if NUM_BOARDS > 1
+		in[2] = I2S0_RDR1;
+		in[3] = I2S0_RDR1;
+		I2S0_TDR1 = 0;
+		I2S0_TDR1 = 0;
+#endif
+		if(settle_state == SETTLE_RUNNING)
+		{
+			for(ch = 0; ch < SETTLE_CHANNELS; ch++)
+				in[ch] >>= 8;
+			settle_frame(in);
+		}
+		return;
+	}
+#ifdef AUDIO_INTERFACE
+	int32_t out_left, out_right;
+
+	if(!test_running)
+	{
+		// No test, so pass audio to and from the host instead (first
+		// board only)
+		dummy_var = I2S0_RDR0; // Left
+		res = I2S0_RDR0; // Right
+		{
+			uint32_t start = prof_start();
+
+			usb_audio_i2s_frame(dummy_var, res, &out_left, &out_right);
+			prof_end(PROF_AUDIO_FRAME, start);
+		}
+		I2S0_TDR0 = out_left;
+		I2S0_TDR0 = out_right;
+#if NUM_BOARDS > 1
+		I2S0_RDR1;
+		I2S0_RDR1;
+		I2S0_TDR1 = 0;
+		I2S0_TDR1 = 0;
+#endif
+		return;
+	}
+#endif
 
 	int32_t outp_samp = (out_buf[tx_buf_idx] << 8);
 
 	//serial_write_string("Entered RX ISR\r\n");
 
-	// output right channel only
-	I2S0_TDR0 = 0;
+	// output on the channel(s) picked with CFG CH, left goes first
+	I2S0_TDR0 = (test_channel & TEST_CH_LEFT) ? outp_samp : 0;
 	//if(output_real_part)
 	//{
-		I2S0_TDR0 = outp_samp;
+		I2S0_TDR0 = (test_channel & TEST_CH_RIGHT) ? outp_samp : 0;
 	//}
 	//else
 	//{
 		//I2S0_TDR0 = out_buf_imag[tx_buf_idx];
 	//}
 	//I2S0_TDR0 = 0;
+#if NUM_BOARDS > 1
+	// Every board gets the same output, on the same frame
+	I2S0_TDR1 = (test_channel & TEST_CH_LEFT) ? outp_samp : 0;
+	I2S0_TDR1 = (test_channel & TEST_CH_RIGHT) ? outp_samp : 0;
+#endif
 	
 	tx_buf_idx++;
 	if(tx_buf_idx >= SIG_LENGTH)
@@ -322,6 +814,16 @@ void i2s0_tx_isr(void)
 	dummy_var = I2S0_RDR0; // Left chan discarded
 	res = I2S0_RDR0; // Right channel data
 	//dummy_var = I2S0_RDR0; // Left chan discarded
+#if NUM_BOARDS > 1
+	// Both lines have to be read, but only one board fits in memory
+	left1 = I2S0_RDR1;
+	right1 = I2S0_RDR1;
+	if(test_board == 1)
+	{
+		dummy_var = left1;
+		res = right1;
+	}
+#endif
 
 	// Save all data up until we're out of space
 	// Throw out first sample
@@ -337,14 +839,23 @@ void i2s0_tx_isr(void)
 	{
 		rx_buf_idx = 0;
 		curr_run++;
+
+		// The next frame is the first one that's kept
+		if(curr_run == 1)
+			capture_start = micros64();
 	}
 
-	if(curr_run >= NUM_RUNS)
+	// One extra run, since the first is thrown out
+	if(curr_run > num_runs)
 	{
+#ifndef AUDIO_INTERFACE
 		i2s_stop();
+#endif
+		capture_end = micros64();
 		curr_run = 0;
 		test_running = 0;
 		rx_buf_idx = 0;
+		event_set(EVENT_TEST);
 	}
 
 	// Don't save data on first run (first run will have ~0s for first
@@ -378,6 +889,14 @@ void i2s0_tx_isr(void)
 //	}
 }
 
+FASTRUN void i2s0_tx_isr(void)
+{
+	uint32_t start = prof_start();
+
+	i2s_frame();
+	prof_end(PROF_I2S_ISR, start);
+}
+
 
 //void i2s0_rx_isr(void)
 //{
@@ -0,0 +1,314 @@
+/******************************************************************************
+* Sine loopback test for SuperAudioBoard
+*
+* usb_audio.c
+*
+* USB Audio Class (1.0) streaming between the host and the I2S interface.
+*
+* Each direction has a single producer/single consumer FIFO of stereo
+* frames: the USB interrupt fills the playback FIFO and the I2S interrupt
+* empties it, and the other way around for recording.  Each side only
+* ever writes its own index, so no interrupt masking is needed.
+*
+* The codec is the clock master, so the host is told how fast to send
+* playback data over an explicit feedback endpoint.  The rate is measured
+* by counting I2S frames over a fixed number of USB SOFs, then nudged a
+* little by how far the playback FIFO is from half full.  Nothing
+* in here touches the hardware (usb_dev.c owns the endpoints), so it can
+* be built and exercised on a PC with a stand-in for usb_dev.c.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#include "usb_audio.h"
+
+#if defined(AUDIO_INTERFACE)
+
+#include "mk20dx128.h"
+#include "usb_dev.h"
+
+// Bytes per stereo frame on the USB side (2 x 24 bit)
+#define AUDIO_FRAME_BYTES 6
+
+// Frames per 1 ms USB frame at the nominal sample rate
+#define FRAMES_PER_PACKET (AUDIO_SAMPLE_RATE / 1000)
+
+// How full the record FIFO is kept, in frames.  Two packets worth
+// rides out the jitter between the I2S and USB interrupts.
+#define REC_TARGET (2 * FRAMES_PER_PACKET)
+
+#define FIFO_MASK (USB_AUDIO_FIFO_FRAMES - 1)
+
+// Feedback is measured over 2^FEEDBACK_SOF_SHIFT USB frames (128 ms)
+#define FEEDBACK_SOF_SHIFT 7
+
+// Feedback values are frames per USB frame in 10.14 fixed point
+#define FEEDBACK_NOMINAL ((uint32_t)FRAMES_PER_PACKET << 14)
+#define FEEDBACK_MIN     ((uint32_t)(FRAMES_PER_PACKET - 1) << 14)
+#define FEEDBACK_MAX     ((uint32_t)(FRAMES_PER_PACKET + 1) << 14)
+
+// Keep the compiler from moving FIFO data accesses past the index update
+#define fifo_barrier() __asm__ volatile("" ::: "memory")
+
+typedef struct
+{
+	int32_t data[USB_AUDIO_FIFO_FRAMES][2];
+	volatile uint16_t head; // only written by the producer
+	volatile uint16_t tail; // only written by the consumer
+} audio_fifo_t;
+
+// Buffers for the isochronous endpoints, one per BDT bank (even/odd).
+// usb_dev.c points the USB DMA straight at these.
+uint8_t usb_audio_receive_buffer[2][AUDIO_RX_SIZE] __attribute__ ((aligned(4)));
+uint8_t usb_audio_transmit_buffer[2][AUDIO_TX_SIZE] __attribute__ ((aligned(4)));
+uint8_t usb_audio_sync_buffer[2][4] __attribute__ ((aligned(4)));
+
+volatile uint8_t usb_audio_receive_setting = 0;
+volatile uint8_t usb_audio_transmit_setting = 0;
+
+volatile uint32_t usb_audio_rx_overruns = 0;
+volatile uint32_t usb_audio_tx_underruns = 0;
+volatile uint32_t usb_audio_play_underruns = 0;
+volatile uint32_t usb_audio_rec_overruns = 0;
+
+static audio_fifo_t play_fifo; // USB -> I2S
+static audio_fifo_t rec_fifo;  // I2S -> USB
+static uint8_t play_primed = 0;
+static uint8_t rec_primed = 0;
+
+// Rate feedback state.  i2s_frame_count is written by the I2S interrupt,
+// everything else by the USB interrupt.
+static volatile uint32_t i2s_frame_count = 0;
+static uint32_t feedback_start_count = 0;
+static uint16_t feedback_sof_count = 0;
+static uint32_t feedback_value = FEEDBACK_NOMINAL;
+
+// USB carries 3 byte little endian samples, I2S wants them left justified
+// in a 32 bit word
+static inline int32_t unpack24(const uint8_t *p)
+{
+	return (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16)
+			| ((uint32_t)p[2] << 24));
+}
+
+static inline void pack24(uint8_t *p, int32_t samp)
+{
+	p[0] = samp >> 8;
+	p[1] = samp >> 16;
+	p[2] = samp >> 24;
+}
+
+// Called from usb_isr() with each isochronous OUT packet
+void usb_audio_receive_callback(const uint8_t *buf, uint32_t len)
+{
+	uint16_t head = play_fifo.head;
+	uint32_t frames = len / AUDIO_FRAME_BYTES;
+	int32_t *slot;
+
+	while(frames > 0)
+	{
+		if((uint16_t)(head - play_fifo.tail) >= USB_AUDIO_FIFO_FRAMES)
+		{
+			// No room, drop the rest of the packet
+			usb_audio_rx_overruns += frames;
+			break;
+		}
+
+		slot = play_fifo.data[head & FIFO_MASK];
+		slot[0] = unpack24(buf);
+		slot[1] = unpack24(buf + 3);
+		buf += AUDIO_FRAME_BYTES;
+		head++;
+		frames--;
+	}
+
+	fifo_barrier();
+	play_fifo.head = head;
+}
+
+// Called from usb_isr() each time an isochronous IN packet has gone out.
+// Fills buf with the next packet and returns its length in bytes.
+uint32_t usb_audio_transmit_callback(uint8_t *buf)
+{
+	uint16_t tail = rec_fifo.tail;
+	uint16_t level = rec_fifo.head - tail;
+	uint32_t n;
+	const int32_t *slot;
+
+	if(!usb_audio_transmit_setting)
+	{
+		// Stream closed, throw away anything left over
+		rec_fifo.tail = rec_fifo.head;
+		rec_primed = 0;
+		return 0;
+	}
+
+	// Let the FIFO fill to the target level before sending anything
+	if(!rec_primed)
+	{
+		if(level < REC_TARGET)
+			return 0;
+		rec_primed = 1;
+	}
+
+	// The codec clock is the master, so send one frame more or less
+	// than nominal to hold the FIFO near the target level (the IN
+	// endpoint is asynchronous, the host takes whatever size we send)
+	n = FRAMES_PER_PACKET;
+	if(level > REC_TARGET + FRAMES_PER_PACKET / 2)
+		n++;
+	else if(level < REC_TARGET - FRAMES_PER_PACKET / 2)
+		n--;
+	if(n > level)
+	{
+		usb_audio_tx_underruns += n - level;
+		n = level;
+	}
+
+	level = n;
+	while(n > 0)
+	{
+		slot = rec_fifo.data[tail & FIFO_MASK];
+		pack24(buf, slot[0]);
+		pack24(buf + 3, slot[1]);
+		buf += AUDIO_FRAME_BYTES;
+		tail++;
+		n--;
+	}
+
+	fifo_barrier();
+	rec_fifo.tail = tail;
+	return level * AUDIO_FRAME_BYTES;
+}
+
+// Called from usb_isr() on every start of frame (once per ms)
+void usb_audio_sof(void)
+{
+	uint32_t count, frames, fb;
+	int32_t error;
+
+	if(++feedback_sof_count < (1 << FEEDBACK_SOF_SHIFT))
+		return;
+	feedback_sof_count = 0;
+
+	count = i2s_frame_count;
+	frames = count - feedback_start_count;
+	feedback_start_count = count;
+
+	// I2S not running (codec not set up yet), nothing to measure
+	if(frames == 0)
+	{
+		feedback_value = FEEDBACK_NOMINAL;
+		return;
+	}
+
+	// frames per 2^7 ms -> frames per ms in 10.14
+	fb = frames << (14 - FEEDBACK_SOF_SHIFT);
+
+	// Measured rate alone would hold whatever level the FIFO happens to
+	// be at, so also steer it back towards half full.  A 64 frame error
+	// changes the rate by 1/16 frame per ms, so it's corrected in ~1 s.
+	error = (int32_t)(USB_AUDIO_FIFO_FRAMES / 2)
+		- (int32_t)(uint16_t)(play_fifo.head - play_fifo.tail);
+	fb += error * 16;
+
+	if(fb < FEEDBACK_MIN)
+		fb = FEEDBACK_MIN;
+	if(fb > FEEDBACK_MAX)
+		fb = FEEDBACK_MAX;
+	feedback_value = fb;
+}
+
+// Called from usb_isr() each time a feedback packet has gone out.
+// Fills buf with the next one and returns its length in bytes.
+uint32_t usb_audio_sync_callback(uint8_t *buf)
+{
+	uint32_t fb = feedback_value;
+
+	buf[0] = fb;
+	buf[1] = fb >> 8;
+	buf[2] = fb >> 16;
+	return 3;
+}
+
+FASTRUN void usb_audio_i2s_frame(int32_t in_left, int32_t in_right,
+		int32_t *out_left, int32_t *out_right)
+{
+	uint16_t head, tail, level;
+	int32_t *slot;
+
+	i2s_frame_count++;
+
+	// I2S -> USB
+	if(usb_audio_transmit_setting)
+	{
+		head = rec_fifo.head;
+		if((uint16_t)(head - rec_fifo.tail) < USB_AUDIO_FIFO_FRAMES)
+		{
+			slot = rec_fifo.data[head & FIFO_MASK];
+			slot[0] = in_left;
+			slot[1] = in_right;
+			fifo_barrier();
+			rec_fifo.head = head + 1;
+		}
+		else
+		{
+			usb_audio_rec_overruns++;
+		}
+	}
+
+	// USB -> I2S
+	if(!usb_audio_receive_setting)
+	{
+		// Stream closed, throw away anything left over
+		play_fifo.tail = play_fifo.head;
+		play_primed = 0;
+	}
+
+	tail = play_fifo.tail;
+	level = play_fifo.head - tail;
+
+	// Wait for the FIFO to half fill before starting playback (and
+	// again after an underrun) so USB jitter doesn't cause dropouts
+	if(!play_primed && (level >= USB_AUDIO_FIFO_FRAMES / 2))
+		play_primed = 1;
+
+	if(play_primed && (level > 0))
+	{
+		slot = play_fifo.data[tail & FIFO_MASK];
+		*out_left = slot[0];
+		*out_right = slot[1];
+		fifo_barrier();
+		play_fifo.tail = tail + 1;
+	}
+	else
+	{
+		*out_left = 0;
+		*out_right = 0;
+		if(play_primed)
+		{
+			usb_audio_play_underruns++;
+			play_primed = 0;
+		}
+	}
+}
+
+#endif // AUDIO_INTERFACE
@@ -0,0 +1,72 @@
+/******************************************************************************
+* Sine loopback test for SuperAudioBoard
+*
+* usb_audio.h
+*
+* USB Audio Class (1.0) streaming between the host and the I2S interface.
+* The board shows up as a 24 bit, 48 kHz stereo sound card.
+*
+* Copyright (c) 2015 RF William Hollender, whollender@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+********************************************************************************/
+
+#ifndef USB_AUDIO_H
+#define USB_AUDIO_H
+
+#include <inttypes.h>
+#include "usb_desc.h"
+
+#if defined(AUDIO_INTERFACE)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Frames (L + R) buffered in each direction between USB and I2S.
+// Must be a power of 2.
+#define USB_AUDIO_FIFO_FRAMES 256
+
+// Call once per I2S frame (from the I2S interrupt).  in_left/in_right are
+// the samples just read from the codec, out_left/out_right are filled in
+// with the samples to write to the codec.  All samples are left justified
+// 32 bit words, same as the I2S data registers.
+void usb_audio_i2s_frame(int32_t in_left, int32_t in_right,
+		int32_t *out_left, int32_t *out_right);
+
+// Nonzero while the host has the corresponding stream open
+extern volatile uint8_t usb_audio_receive_setting;
+extern volatile uint8_t usb_audio_transmit_setting;
+
+// Frames dropped because a FIFO was empty (underrun) or full (overrun).
+// The USB and I2S interrupts can preempt each other, so each count has
+// only one writer: rx/tx are kept by the USB interrupt (OUT packets that
+// didn't fit, IN packets sent short), play/rec by the I2S interrupt.
+extern volatile uint32_t usb_audio_rx_overruns;
+extern volatile uint32_t usb_audio_tx_underruns;
+extern volatile uint32_t usb_audio_play_underruns;
+extern volatile uint32_t usb_audio_rec_overruns;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_INTERFACE
+
+#endif
@@ -389,6 +389,196 @@ static uint8_t config_descriptor[CONFIG_DESC_SIZE] = {
         0,                                      // bInterval
 #endif // CDC_DATA_INTERFACE
 
+#ifdef AUDIO_INTERFACE
+        // interface association descriptor, USB ECN, Table 9-Z
+        8,                                      // bLength
+        11,                                     // bDescriptorType
+        AUDIO_INTERFACE,                        // bFirstInterface
+        3,                                      // bInterfaceCount
+        0x01,                                   // bFunctionClass
+        0x01,                                   // bFunctionSubClass
+        0x00,                                   // bFunctionProtocol
+        0,                                      // iFunction
+        // Standard AudioControl Interface Descriptor, Audio 1.0, 4.3.1, Table 4-1
+        9,                                      // bLength
+        4,                                      // bDescriptorType
+        AUDIO_INTERFACE,                        // bInterfaceNumber
+        0,                                      // bAlternateSetting
+        0,                                      // bNumEndpoints
+        1,                                      // bInterfaceClass, 1 = AUDIO
+        1,                                      // bInterfaceSubclass, 1 = AUDIO_CONTROL
+        0,                                      // bInterfaceProtocol
+        0,                                      // iInterface
+        // Class-Specific AC Interface Header Descriptor, Audio 1.0, 4.3.2, Table 4-2
+        10,                                     // bLength
+        0x24,                                   // bDescriptorType, 0x24 = CS_INTERFACE
+        0x01,                                   // bDescriptorSubtype, 1 = HEADER
+        0x00, 0x01,                             // bcdADC (version 1.0)
+        LSB(52), MSB(52),                       // wTotalLength
+        2,                                      // bInCollection
+        AUDIO_RX_INTERFACE,                     // baInterfaceNr(1)
+        AUDIO_TX_INTERFACE,                     // baInterfaceNr(2)
+        // Input Terminal Descriptor, Audio 1.0, 4.3.2.1, Table 4-3
+        12,                                     // bLength
+        0x24,                                   // bDescriptorType, 0x24 = CS_INTERFACE
+        0x02,                                   // bDescriptorSubType, 2 = INPUT_TERMINAL
+        1,                                      // bTerminalID
+        0x01, 0x01,                             // wTerminalType, 0x0101 = USB_STREAMING
+        0,                                      // bAssocTerminal
+        2,                                      // bNrChannels
+        0x03, 0x00,                             // wChannelConfig, 0x0003 = Left & Right Front
+        0,                                      // iChannelNames
+        0,                                      // iTerminal
+        // Output Terminal Descriptor, Audio 1.0, 4.3.2.2, Table 4-4
+        9,                                      // bLength
+        0x24,                                   // bDescriptorType, 0x24 = CS_INTERFACE
+        0x03,                                   // bDescriptorSubtype, 3 = OUTPUT_TERMINAL
+        2,                                      // bTerminalID
+        0x03, 0x06,                             // wTerminalType, 0x0603 = Line Connector
+        0,                                      // bAssocTerminal
+        1,                                      // bSourceID
+        0,                                      // iTerminal
+        // Input Terminal Descriptor, Audio 1.0, 4.3.2.1, Table 4-3
+        12,                                     // bLength
+        0x24,                                   // bDescriptorType, 0x24 = CS_INTERFACE
+        0x02,                                   // bDescriptorSubType, 2 = INPUT_TERMINAL
+        3,                                      // bTerminalID
+        0x03, 0x06,                             // wTerminalType, 0x0603 = Line Connector
+        0,                                      // bAssocTerminal
+        2,                                      // bNrChannels
+        0x03, 0x00,                             // wChannelConfig, 0x0003 = Left & Right Front
+        0,                                      // iChannelNames
+        0,                                      // iTerminal
+        // Output Terminal Descriptor, Audio 1.0, 4.3.2.2, Table 4-4
+        9,                                      // bLength
+        0x24,                                   // bDescriptorType, 0x24 = CS_INTERFACE
+        0x03,                                   // bDescriptorSubtype, 3 = OUTPUT_TERMINAL
+        4,                                      // bTerminalID
+        0x01, 0x01,                             // wTerminalType, 0x0101 = USB_STREAMING
+        0,                                      // bAssocTerminal
+        3,                                      // bSourceID
+        0,                                      // iTerminal
+
+        // Standard AS Interface Descriptor, Audio 1.0, 4.5.1, Table 4-18
+        // Alternate 0: default setting, disabled zero bandwidth
+        9,                                      // bLength
+        4,                                      // bDescriptorType, 4 = INTERFACE
+        AUDIO_RX_INTERFACE,                     // bInterfaceNumber
+        0,                                      // bAlternateSetting
+        0,                                      // bNumEndpoints
+        1,                                      // bInterfaceClass, 1 = AUDIO
+        2,                                      // bInterfaceSubclass, 2 = AUDIO_STREAMING
+        0,                                      // bInterfaceProtocol
+        0,                                      // iInterface
+        // Alternate 1: streaming data
+        9,                                      // bLength
+        4,                                      // bDescriptorType, 4 = INTERFACE
+        AUDIO_RX_INTERFACE,                     // bInterfaceNumber
+        1,                                      // bAlternateSetting
+        2,                                      // bNumEndpoints
+        1,                                      // bInterfaceClass, 1 = AUDIO
+        2,                                      // bInterfaceSubclass, 2 = AUDIO_STREAMING
+        0,                                      // bInterfaceProtocol
+        0,                                      // iInterface
+        // Class-Specific AS Interface Descriptor, Audio 1.0, 4.5.2, Table 4-19
+        7,                                      // bLength
+        0x24,                                   // bDescriptorType, 0x24 = CS_INTERFACE
+        1,                                      // bDescriptorSubtype, 1 = AS_GENERAL
+        1,                                      // bTerminalLink: Terminal ID = 1
+        1,                                      // bDelay (approx 1ms delay)
+        0x01, 0x00,                             // wFormatTag, 0x0001 = PCM
+        // Type I Format Descriptor, Audio 1.0 Formats, 2.2.5, Table 2-1
+        11,                                     // bLength
+        0x24,                                   // bDescriptorType = CS_INTERFACE
+        2,                                      // bDescriptorSubtype = FORMAT_TYPE
+        1,                                      // bFormatType = FORMAT_TYPE_I
+        2,                                      // bNrChannels = 2
+        3,                                      // bSubFrameSize = 3 bytes
+        24,                                     // bBitResolution = 24 bits
+        1,                                      // bSamFreqType = 1 frequency
+        LSB(AUDIO_SAMPLE_RATE), MSB(AUDIO_SAMPLE_RATE), 0, // tSamFreq
+        // Standard AS Isochronous Audio Data Endpoint Descriptor, Audio 1.0, 4.6.1.1, Table 4-20
+        9,                                      // bLength
+        5,                                      // bDescriptorType, 5 = ENDPOINT_DESCRIPTOR
+        AUDIO_RX_ENDPOINT,                      // bEndpointAddress
+        0x05,                                   // bmAttributes = isochronous, asynchronous
+        LSB(AUDIO_RX_SIZE), MSB(AUDIO_RX_SIZE), // wMaxPacketSize
+        1,                                      // bInterval, 1 = every frame
+        0,                                      // bRefresh
+        AUDIO_SYNC_ENDPOINT | 0x80,             // bSynchAddress
+        // Class-Specific AS Isochronous Audio Data Endpoint Descriptor, Audio 1.0, 4.6.1.2, Table 4-21
+        7,                                      // bLength
+        0x25,                                   // bDescriptorType, 0x25 = CS_ENDPOINT
+        1,                                      // bDescriptorSubtype, 1 = EP_GENERAL
+        0x00,                                   // bmAttributes
+        0,                                      // bLockDelayUnits, 1 = ms
+        0x00, 0x00,                             // wLockDelay
+        // Standard AS Isochronous Synch Endpoint Descriptor, Audio 1.0, 4.6.2.1, Table 4-22
+        9,                                      // bLength
+        5,                                      // bDescriptorType, 5 = ENDPOINT_DESCRIPTOR
+        AUDIO_SYNC_ENDPOINT | 0x80,             // bEndpointAddress
+        0x11,                                   // bmAttributes = isochronous, feedback
+        3, 0,                                   // wMaxPacketSize, 3 bytes
+        1,                                      // bInterval, 1 = every frame
+        5,                                      // bRefresh, 5 = 32ms
+        0,                                      // bSynchAddress
+
+        // Standard AS Interface Descriptor, Audio 1.0, 4.5.1, Table 4-18
+        // Alternate 0: default setting, disabled zero bandwidth
+        9,                                      // bLength
+        4,                                      // bDescriptorType, 4 = INTERFACE
+        AUDIO_TX_INTERFACE,                     // bInterfaceNumber
+        0,                                      // bAlternateSetting
+        0,                                      // bNumEndpoints
+        1,                                      // bInterfaceClass, 1 = AUDIO
+        2,                                      // bInterfaceSubclass, 2 = AUDIO_STREAMING
+        0,                                      // bInterfaceProtocol
+        0,                                      // iInterface
+        // Alternate 1: streaming data
+        9,                                      // bLength
+        4,                                      // bDescriptorType, 4 = INTERFACE
+        AUDIO_TX_INTERFACE,                     // bInterfaceNumber
+        1,                                      // bAlternateSetting
+        1,                                      // bNumEndpoints
+        1,                                      // bInterfaceClass, 1 = AUDIO
+        2,                                      // bInterfaceSubclass, 2 = AUDIO_STREAMING
+        0,                                      // bInterfaceProtocol
+        0,                                      // iInterface
+        // Class-Specific AS Interface Descriptor, Audio 1.0, 4.5.2, Table 4-19
+        7,                                      // bLength
+        0x24,                                   // bDescriptorType, 0x24 = CS_INTERFACE
+        1,                                      // bDescriptorSubtype, 1 = AS_GENERAL
+        4,                                      // bTerminalLink: Terminal ID = 4
+        1,                                      // bDelay (approx 1ms delay)
+        0x01, 0x00,                             // wFormatTag, 0x0001 = PCM
+        // Type I Format Descriptor, Audio 1.0 Formats, 2.2.5, Table 2-1
+        11,                                     // bLength
+        0x24,                                   // bDescriptorType = CS_INTERFACE
+        2,                                      // bDescriptorSubtype = FORMAT_TYPE
+        1,                                      // bFormatType = FORMAT_TYPE_I
+        2,                                      // bNrChannels = 2
+        3,                                      // bSubFrameSize = 3 bytes
+        24,                                     // bBitResolution = 24 bits
+        1,                                      // bSamFreqType = 1 frequency
+        LSB(AUDIO_SAMPLE_RATE), MSB(AUDIO_SAMPLE_RATE), 0, // tSamFreq
+        // Standard AS Isochronous Audio Data Endpoint Descriptor, Audio 1.0, 4.6.1.1, Table 4-20
+        9,                                      // bLength
+        5,                                      // bDescriptorType, 5 = ENDPOINT_DESCRIPTOR
+        AUDIO_TX_ENDPOINT | 0x80,               // bEndpointAddress
+        0x05,                                   // bmAttributes = isochronous, asynchronous
+        LSB(AUDIO_TX_SIZE), MSB(AUDIO_TX_SIZE), // wMaxPacketSize
+        1,                                      // bInterval, 1 = every frame
+        0,                                      // bRefresh
+        0,                                      // bSynchAddress
+        // Class-Specific AS Isochronous Audio Data Endpoint Descriptor, Audio 1.0, 4.6.1.2, Table 4-21
+        7,                                      // bLength
+        0x25,                                   // bDescriptorType, 0x25 = CS_ENDPOINT
+        1,                                      // bDescriptorSubtype, 1 = EP_GENERAL
+        0x00,                                   // bmAttributes
+        0,                                      // bLockDelayUnits, 1 = ms
+        0x00, 0x00,                             // wLockDelay
+#endif // AUDIO_INTERFACE
+
 #ifdef MIDI_INTERFACE
         // Standard MS Interface Descriptor,
         9,                                      // bLength
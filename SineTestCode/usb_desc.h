@@ -43,6 +43,8 @@
 #define ENDPOINT_TRANSIMIT_ONLY		0x15
 #define ENDPOINT_RECEIVE_ONLY		0x19
 #define ENDPOINT_TRANSMIT_AND_RECEIVE	0x1D
+#define ENDPOINT_RECEIVE_ISOCHRONOUS	0x18
+#define ENDPOINT_TRANSMIT_ISOCHRONOUS	0x14
 
 /*
 To modify a USB Type to have different interfaces, start in this
@@ -193,6 +195,46 @@ let me know?  http://forum.pjrc.com/forums/4-Suggestions-amp-Bug-Reports
   #define ENDPOINT5_CONFIG	ENDPOINT_TRANSIMIT_ONLY
   #define ENDPOINT6_CONFIG	ENDPOINT_TRANSIMIT_ONLY
 
+#elif defined(USB_SERIAL_AUDIO)
+  #define VENDOR_ID		0x16C0
+  #define PRODUCT_ID		0x048A
+  #define DEVICE_CLASS		0xEF
+  #define DEVICE_SUBCLASS	0x02
+  #define DEVICE_PROTOCOL	0x01
+  #define MANUFACTURER_NAME	{'T','e','e','n','s','y','d','u','i','n','o'}
+  #define MANUFACTURER_NAME_LEN	11
+  #define PRODUCT_NAME		{'S','u','p','e','r','A','u','d','i','o','B','o','a','r','d'}
+  #define PRODUCT_NAME_LEN	15
+  #define EP0_SIZE		64
+  #define NUM_ENDPOINTS		7
+  #define NUM_USB_BUFFERS	12
+  #define NUM_INTERFACE		5
+  #define CDC_IAD_DESCRIPTOR	1
+  #define CDC_STATUS_INTERFACE	0
+  #define CDC_DATA_INTERFACE	1	// Serial
+  #define CDC_ACM_ENDPOINT	2
+  #define CDC_RX_ENDPOINT       3
+  #define CDC_TX_ENDPOINT       4
+  #define CDC_ACM_SIZE          16
+  #define CDC_RX_SIZE           64
+  #define CDC_TX_SIZE           64
+  #define AUDIO_INTERFACE	2	// Audio (control)
+  #define AUDIO_RX_INTERFACE	3	// Audio stream, host to SuperAudioBoard
+  #define AUDIO_TX_INTERFACE	4	// Audio stream, SuperAudioBoard to host
+  #define AUDIO_RX_ENDPOINT	5
+  #define AUDIO_RX_SIZE		294	// 49 frames of 24 bit stereo
+  #define AUDIO_TX_ENDPOINT	6
+  #define AUDIO_TX_SIZE		294
+  #define AUDIO_SYNC_ENDPOINT	7	// rate feedback for AUDIO_RX_ENDPOINT
+  #define AUDIO_SAMPLE_RATE	48000
+  #define CONFIG_DESC_SIZE	(9+8 + 9+5+5+4+5+7+9+7+7 + 8+9+52 + 9+9+7+11+9+7+9 + 9+9+7+11+9+7)
+  #define ENDPOINT2_CONFIG	ENDPOINT_TRANSIMIT_ONLY
+  #define ENDPOINT3_CONFIG	ENDPOINT_RECEIVE_ONLY
+  #define ENDPOINT4_CONFIG	ENDPOINT_TRANSIMIT_ONLY
+  #define ENDPOINT5_CONFIG	ENDPOINT_RECEIVE_ISOCHRONOUS
+  #define ENDPOINT6_CONFIG	ENDPOINT_TRANSMIT_ISOCHRONOUS
+  #define ENDPOINT7_CONFIG	ENDPOINT_TRANSMIT_ISOCHRONOUS
+
 #elif defined(USB_MIDI)
   #define VENDOR_ID		0x16C0
   #define PRODUCT_ID		0x0485
@@ -32,6 +32,8 @@
 //#include "HardwareSerial.h"
 #include "usb_dev.h"
 #include "usb_mem.h"
+#include "profile.h"
+#include "event.h"
 
 // buffer descriptor table
 
@@ -43,11 +45,109 @@ typedef struct {
 __attribute__ ((section(".usbdescriptortable"), used))
 static bdt_t table[(NUM_ENDPOINTS+1)*4];
 
-static usb_packet_t *rx_first[NUM_ENDPOINTS];
-static usb_packet_t *rx_last[NUM_ENDPOINTS];
-static usb_packet_t *tx_first[NUM_ENDPOINTS];
-static usb_packet_t *tx_last[NUM_ENDPOINTS];
-uint16_t usb_rx_byte_count_data[NUM_ENDPOINTS];
+// Packet queues, one ring of packet pointers per endpoint and direction.
+// Each ring can hold every packet in the pool, so it never fills.  Both
+// ends are updated with LDREX/STREX instead of masking interrupts, and
+// either end can be used from the main loop and interrupts at once.
+//
+// A producer first reserves its slots by moving head on, then publishes
+// each packet by storing it in its slot.  An empty slot is NULL, so a
+// consumer that reaches a slot that's reserved but not written yet (an
+// interrupt landed between the two steps) stops there as if the queue
+// were empty; the producer pends the USB interrupt after publishing, so
+// the packet is picked up then.  The consumer takes a slot by moving tail
+// on, and only then empties it.
+#if NUM_USB_BUFFERS <= 16
+#define USB_QUEUE_SIZE 16
+#elif NUM_USB_BUFFERS <= 32
+#define USB_QUEUE_SIZE 32
+#elif NUM_USB_BUFFERS <= 64
+#define USB_QUEUE_SIZE 64
+#elif NUM_USB_BUFFERS <= 128
+#define USB_QUEUE_SIZE 128
+#elif NUM_USB_BUFFERS <= 256
+#define USB_QUEUE_SIZE 256
+#elif NUM_USB_BUFFERS <= 512
+#define USB_QUEUE_SIZE 512
+#else
+#define USB_QUEUE_SIZE 1024
+#endif
+
+typedef struct {
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	usb_packet_t * volatile slot[USB_QUEUE_SIZE];
+} usb_queue_t;
+
+static usb_queue_t rx_queue[NUM_ENDPOINTS];
+static usb_queue_t tx_queue[NUM_ENDPOINTS];
+volatile uint16_t usb_rx_byte_count_data[NUM_ENDPOINTS];
+
+// endpoints with newly queued transmit packets, for usb_isr to load
+static volatile uint32_t tx_kick;
+
+static void usb_queue_put(usb_queue_t *q, usb_packet_t *packet)
+{
+	uint32_t head;
+
+	do {
+		head = __ldrexw(&q->head);
+	} while (__strexw(head + 1, &q->head));
+	q->slot[head & (USB_QUEUE_SIZE - 1)] = packet;
+}
+
+// queue several packets with a single head update
+static void usb_queue_put_multi(usb_queue_t *q, usb_packet_t **packets, uint32_t count)
+{
+	uint32_t head, i;
+
+	do {
+		head = __ldrexw(&q->head);
+	} while (__strexw(head + count, &q->head));
+	for (i=0; i < count; i++) {
+		q->slot[(head + i) & (USB_QUEUE_SIZE - 1)] = packets[i];
+	}
+}
+
+static usb_packet_t *usb_queue_get(usb_queue_t *q)
+{
+	uint32_t tail;
+	usb_packet_t *packet;
+
+	do {
+		tail = __ldrexw(&q->tail);
+		if (tail == q->head) {
+			__clrex();
+			return NULL;
+		}
+		packet = q->slot[tail & (USB_QUEUE_SIZE - 1)];
+		if (!packet) {
+			// reserved but not published yet
+			__clrex();
+			return NULL;
+		}
+	} while (__strexw(tail + 1, &q->tail));
+	q->slot[tail & (USB_QUEUE_SIZE - 1)] = NULL;
+	return packet;
+}
+
+// tail is read first: it only moves toward head, so head - tail can't
+// come out negative if the interrupt takes packets in between
+static inline uint32_t usb_queue_count(const usb_queue_t *q)
+{
+	uint32_t tail = q->tail;
+
+	return q->head - tail;
+}
+
+static inline void usb_rx_byte_count_add(uint32_t endpoint, int32_t n)
+{
+	uint16_t count;
+
+	do {
+		count = __ldrexh(&usb_rx_byte_count_data[endpoint]);
+	} while (__strexh(count + n, &usb_rx_byte_count_data[endpoint]));
+}
 
 static uint8_t tx_state[NUM_ENDPOINTS];
 #define TX_STATE_BOTH_FREE_EVEN_FIRST	0
@@ -77,6 +177,21 @@ static uint8_t tx_state[NUM_ENDPOINTS];
 #define index(endpoint, tx, odd) (((endpoint) << 2) | ((tx) << 1) | (odd))
 #define stat2bufferdescriptor(stat) (table + ((stat) >> 2))
 
+// zero-copy transmit, see usb_tx_ref()
+typedef struct {
+	const uint8_t *buffer;
+	const uint8_t *data;
+	volatile uint32_t remaining;
+	uint16_t packet_size;
+	usb_tx_ref_callback_t callback;
+} tx_ref_t;
+
+static tx_ref_t tx_ref[NUM_ENDPOINTS];
+// which transmit BDTs hold part of a zero-copy buffer rather than a
+// usb_packet_t: bit 0 = even, bit 1 = odd
+static uint8_t tx_ref_bdt[NUM_ENDPOINTS];
+#define TX_REF_BDT_BANK(b) (((uint32_t)(b) & 8) ? 2 : 1)
+
 
 static union {
  struct {
@@ -148,6 +263,30 @@ static void endpoint0_transmit(const void *data, uint32_t len)
 	ep0_tx_bdt_bank ^= 1;
 }
 
+// called with the endpoint's zero-copy buffer completely sent (or aborted)
+static void tx_ref_done(uint32_t i)
+{
+	usb_tx_ref_callback_t callback = tx_ref[i].callback;
+	const uint8_t *buffer = tx_ref[i].buffer;
+
+	tx_ref[i].buffer = NULL;
+	tx_ref[i].callback = NULL;
+	if (callback) callback(buffer);
+}
+
+// point a transmit BDT at the next chunk of the endpoint's zero-copy buffer
+static void tx_ref_arm(uint32_t i, bdt_t *b)
+{
+	uint32_t len = tx_ref[i].remaining;
+
+	if (len > tx_ref[i].packet_size) len = tx_ref[i].packet_size;
+	b->addr = (void *)tx_ref[i].data;
+	tx_ref[i].data += len;
+	tx_ref[i].remaining -= len;
+	tx_ref_bdt[i] |= TX_REF_BDT_BANK(b);
+	b->desc = BDT_DESC(len, ((uint32_t)b & 8) ? DATA1 : DATA0);
+}
+
 static uint8_t reply_buffer[8];
 
 static void usb_setup(void)
@@ -171,29 +310,34 @@ static void usb_setup(void)
 		cfg = usb_endpoint_config_table;
 		// clear all BDT entries, free any allocated memory...
 		for (i=4; i < (NUM_ENDPOINTS+1)*4; i++) {
+			if ((i & 2) && (tx_ref_bdt[(i >> 2) - 1] & ((i & 1) ? 2 : 1))) {
+				continue; // zero-copy buffer, not ours to free
+			}
+#ifdef AUDIO_INTERFACE
+			if ((i >> 2) == AUDIO_RX_ENDPOINT || (i >> 2) == AUDIO_TX_ENDPOINT
+			  || (i >> 2) == AUDIO_SYNC_ENDPOINT) {
+				continue; // static isochronous buffers
+			}
+#endif
 			if (table[i].desc & BDT_OWN) {
 				usb_free((usb_packet_t *)((uint8_t *)(table[i].addr) - 8));
 			}
 		}
+		// abort any zero-copy transfers
+		for (i=0; i < NUM_ENDPOINTS; i++) {
+			tx_ref_bdt[i] = 0;
+			tx_ref[i].remaining = 0;
+			if (tx_ref[i].buffer) tx_ref_done(i);
+		}
 		// free all queued packets
 		for (i=0; i < NUM_ENDPOINTS; i++) {
-			usb_packet_t *p, *n;
-			p = rx_first[i];
-			while (p) {
-				n = p->next;
+			usb_packet_t *p;
+			while ((p = usb_queue_get(&rx_queue[i])) != NULL) {
 				usb_free(p);
-				p = n;
 			}
-			rx_first[i] = NULL;
-			rx_last[i] = NULL;
-			p = tx_first[i];
-			while (p) {
-				n = p->next;
+			while ((p = usb_queue_get(&tx_queue[i])) != NULL) {
 				usb_free(p);
-				p = n;
 			}
-			tx_first[i] = NULL;
-			tx_last[i] = NULL;
 			usb_rx_byte_count_data[i] = 0;
 			switch (tx_state[i]) {
 			  case TX_STATE_EVEN_FREE:
@@ -209,10 +353,22 @@ static void usb_setup(void)
 			}
 		}
 		usb_rx_memory_needed = 0;
+#ifdef AUDIO_INTERFACE
+		usb_audio_receive_setting = 0;
+		usb_audio_transmit_setting = 0;
+#endif
 		for (i=1; i <= NUM_ENDPOINTS; i++) {
 			epconf = *cfg++;
 			*reg = epconf;
 			reg += 4;
+#ifdef AUDIO_INTERFACE
+			if (i == AUDIO_RX_ENDPOINT) {
+				table[index(i, RX, EVEN)].addr = usb_audio_receive_buffer[0];
+				table[index(i, RX, EVEN)].desc = (AUDIO_RX_SIZE << 16) | BDT_OWN;
+				table[index(i, RX, ODD)].addr = usb_audio_receive_buffer[1];
+				table[index(i, RX, ODD)].desc = (AUDIO_RX_SIZE << 16) | BDT_OWN;
+			} else
+#endif
 			if (epconf & USB_ENDPT_EPRXEN) {
 				usb_packet_t *p;
 				p = usb_malloc();
@@ -234,6 +390,23 @@ static void usb_setup(void)
 			}
 			table[index(i, TX, EVEN)].desc = 0;
 			table[index(i, TX, ODD)].desc = 0;
+#ifdef AUDIO_INTERFACE
+			if (i == AUDIO_TX_ENDPOINT) {
+				// isochronous IN always has a packet ready, zero
+				// length until the host opens the stream
+				table[index(i, TX, EVEN)].addr = usb_audio_transmit_buffer[0];
+				table[index(i, TX, EVEN)].desc = BDT_OWN;
+				table[index(i, TX, ODD)].addr = usb_audio_transmit_buffer[1];
+				table[index(i, TX, ODD)].desc = BDT_OWN;
+			} else if (i == AUDIO_SYNC_ENDPOINT) {
+				table[index(i, TX, EVEN)].addr = usb_audio_sync_buffer[0];
+				table[index(i, TX, EVEN)].desc = (usb_audio_sync_callback(
+					usb_audio_sync_buffer[0]) << 16) | BDT_OWN;
+				table[index(i, TX, ODD)].addr = usb_audio_sync_buffer[1];
+				table[index(i, TX, ODD)].desc = (usb_audio_sync_callback(
+					usb_audio_sync_buffer[1]) << 16) | BDT_OWN;
+			}
+#endif
 		}
 		break;
 	  case 0x0880: // GET_CONFIGURATION
@@ -241,6 +414,35 @@ static void usb_setup(void)
 		datalen = 1;
 		data = reply_buffer;
 		break;
+#ifdef AUDIO_INTERFACE
+	  case 0x0B01: // SET_INTERFACE (alternate setting)
+		// the streaming interfaces have alternate settings 0 (closed)
+		// and 1 (open), everything else only 0
+		if (setup.wValue > 1) {
+			endpoint0_stall();
+			return;
+		}
+		if (setup.wIndex == AUDIO_RX_INTERFACE) {
+			usb_audio_receive_setting = setup.wValue;
+		} else if (setup.wIndex == AUDIO_TX_INTERFACE) {
+			usb_audio_transmit_setting = setup.wValue;
+		} else if (setup.wValue != 0) {
+			endpoint0_stall();
+			return;
+		}
+		break;
+	  case 0x0A81: // GET_INTERFACE (alternate setting)
+		if (setup.wIndex == AUDIO_RX_INTERFACE) {
+			reply_buffer[0] = usb_audio_receive_setting;
+		} else if (setup.wIndex == AUDIO_TX_INTERFACE) {
+			reply_buffer[0] = usb_audio_transmit_setting;
+		} else {
+			reply_buffer[0] = 0;
+		}
+		datalen = 1;
+		data = reply_buffer;
+		break;
+#endif
 	  case 0x0080: // GET_STATUS (device)
 		reply_buffer[0] = 0;
 		reply_buffer[1] = 0;
@@ -527,11 +729,8 @@ usb_packet_t *usb_rx(uint32_t endpoint)
 	usb_packet_t *ret;
 	endpoint--;
 	if (endpoint >= NUM_ENDPOINTS) return NULL;
-	__disable_irq();
-	ret = rx_first[endpoint];
-	if (ret) rx_first[endpoint] = ret->next;
-	usb_rx_byte_count_data[endpoint] -= ret->len;
-	__enable_irq();
+	ret = usb_queue_get(&rx_queue[endpoint]);
+	if (ret) usb_rx_byte_count_add(endpoint, -(int32_t)ret->len);
 	//serial_print("rx, epidx=");
 	//serial_phex(endpoint);
 	//serial_print(", packet=");
@@ -540,15 +739,20 @@ usb_packet_t *usb_rx(uint32_t endpoint)
 	return ret;
 }
 
-static uint32_t usb_queue_byte_count(const usb_packet_t *p)
+// Only a snapshot: packets can be queued or sent while this runs.  A
+// slot is NULL while reserved but not yet published, and again once
+// usb_queue_get() has taken its packet, so the count stops there.
+static uint32_t usb_queue_byte_count(const usb_queue_t *q)
 {
-	uint32_t count=0;
-
-	__disable_irq();
-	for ( ; p; p = p->next) {
-		count += p->len;
+	uint32_t count=0, i, n, tail = q->tail;
+	usb_packet_t *packet;
+
+	n = q->head - tail;
+	for (i = 0; i < n; i++) {
+		packet = q->slot[(tail + i) & (USB_QUEUE_SIZE - 1)];
+		if (!packet) break;
+		count += packet->len;
 	}
-	__enable_irq();
 	return count;
 }
 
@@ -559,7 +763,7 @@ uint32_t usb_rx_byte_count(uint32_t endpoint)
 	endpoint--;
 	if (endpoint >= NUM_ENDPOINTS) return 0;
 	return usb_rx_byte_count_data[endpoint];
-	//return usb_queue_byte_count(rx_first[endpoint]);
+	//return usb_queue_byte_count(&rx_queue[endpoint]);
 }
 */
 
@@ -567,20 +771,14 @@ uint32_t usb_tx_byte_count(uint32_t endpoint)
 {
 	endpoint--;
 	if (endpoint >= NUM_ENDPOINTS) return 0;
-	return usb_queue_byte_count(tx_first[endpoint]);
+	return usb_queue_byte_count(&tx_queue[endpoint]);
 }
 
 uint32_t usb_tx_packet_count(uint32_t endpoint)
 {
-	const usb_packet_t *p;
-	uint32_t count=0;
-
 	endpoint--;
 	if (endpoint >= NUM_ENDPOINTS) return 0;
-	__disable_irq();
-	for (p = tx_first[endpoint]; p; p = p->next) count++;
-	__enable_irq();
-	return count;
+	return usb_queue_count(&tx_queue[endpoint]);
 }
 
 
@@ -597,15 +795,21 @@ void usb_rx_memory(usb_packet_t *packet)
 	unsigned int i;
 	const uint8_t *cfg;
 
+	uint32_t start;
+
 	cfg = usb_endpoint_config_table;
 	//serial_print("rx_mem:");
+	// Called from the main loop and interrupts, but the stage is only
+	// updated with interrupts off, so that's safe
 	__disable_irq();
+	start = prof_start();
 	for (i=1; i <= NUM_ENDPOINTS; i++) {
 		if (*cfg++ & USB_ENDPT_EPRXEN) {
 			if (table[index(i, RX, EVEN)].desc == 0) {
 				table[index(i, RX, EVEN)].addr = packet->buf;
 				table[index(i, RX, EVEN)].desc = BDT_DESC(64, 0);
 				usb_rx_memory_needed--;
+				prof_end(PROF_USB_IRQ_OFF, start);
 				__enable_irq();
 				//serial_phex(i);
 				//serial_print(",even\n");
@@ -615,6 +819,7 @@ void usb_rx_memory(usb_packet_t *packet)
 				table[index(i, RX, ODD)].addr = packet->buf;
 				table[index(i, RX, ODD)].desc = BDT_DESC(64, 1);
 				usb_rx_memory_needed--;
+				prof_end(PROF_USB_IRQ_OFF, start);
 				__enable_irq();
 				//serial_phex(i);
 				//serial_print(",odd\n");
@@ -622,6 +827,7 @@ void usb_rx_memory(usb_packet_t *packet)
 			}
 		}
 	}
+	prof_end(PROF_USB_IRQ_OFF, start);
 	__enable_irq();
 	// we should never reach this point.  If we get here, it means
 	// usb_rx_memory_needed was set greater than zero, but no memory
@@ -634,46 +840,79 @@ void usb_rx_memory(usb_packet_t *packet)
 //#define index(endpoint, tx, odd) (((endpoint) << 2) | ((tx) << 1) | (odd))
 //#define stat2bufferdescriptor(stat) (table + ((stat) >> 2))
 
+// Queue a packet and let usb_isr load it into a buffer descriptor.  Only
+// usb_isr touches the transmit BDTs and tx_state, so nothing here needs
+// interrupts masked; the USB interrupt is set pending to pick it up.
 void usb_tx(uint32_t endpoint, usb_packet_t *packet)
 {
-	bdt_t *b = &table[index(endpoint, TX, EVEN)];
-	uint8_t next;
+	uint32_t kick;
 
 	endpoint--;
 	if (endpoint >= NUM_ENDPOINTS) return;
-	__disable_irq();
-	//serial_print("txstate=");
-	//serial_phex(tx_state[endpoint]);
-	//serial_print("\n");
-	switch (tx_state[endpoint]) {
-	  case TX_STATE_BOTH_FREE_EVEN_FIRST:
-		next = TX_STATE_ODD_FREE;
-		break;
-	  case TX_STATE_BOTH_FREE_ODD_FIRST:
-		b++;
-		next = TX_STATE_EVEN_FREE;
-		break;
-	  case TX_STATE_EVEN_FREE:
-		next = TX_STATE_NONE_FREE_ODD_FIRST;
-		break;
-	  case TX_STATE_ODD_FREE:
-		b++;
-		next = TX_STATE_NONE_FREE_EVEN_FIRST;
-		break;
-	  default:
-		if (tx_first[endpoint] == NULL) {
-			tx_first[endpoint] = packet;
+	usb_queue_put(&tx_queue[endpoint], packet);
+	do {
+		kick = __ldrexw(&tx_kick);
+	} while (__strexw(kick | (1 << endpoint), &tx_kick));
+	NVIC_SET_PENDING(IRQ_USBOTG);
+}
+
+// Queue several packets at once: one queue update, one kick and one
+// interrupt for the whole batch instead of one per packet.
+// Only the serial writers in the main loop call this, so PROF_USB_TX is
+// measured from the one context.
+void usb_tx_multi(uint32_t endpoint, usb_packet_t **packets, uint32_t count)
+{
+	uint32_t kick;
+	uint32_t start = prof_start();
+
+	endpoint--;
+	if (endpoint >= NUM_ENDPOINTS || count == 0) return;
+	usb_queue_put_multi(&tx_queue[endpoint], packets, count);
+	do {
+		kick = __ldrexw(&tx_kick);
+	} while (__strexw(kick | (1 << endpoint), &tx_kick));
+	NVIC_SET_PENDING(IRQ_USBOTG);
+	prof_end(PROF_USB_TX, start);
+}
+
+// Called only from usb_isr: load any free transmit BDTs, from the
+// zero-copy buffer first, then from the queue
+static void usb_tx_fill(uint32_t endpoint)
+{
+	bdt_t *b = &table[index(endpoint + 1, TX, EVEN)];
+	usb_packet_t *packet;
+	uint8_t next;
+
+	while (1) {
+		switch (tx_state[endpoint]) {
+		  case TX_STATE_BOTH_FREE_EVEN_FIRST:
+			next = TX_STATE_ODD_FREE;
+			break;
+		  case TX_STATE_BOTH_FREE_ODD_FIRST:
+			b++;
+			next = TX_STATE_EVEN_FREE;
+			break;
+		  case TX_STATE_EVEN_FREE:
+			next = TX_STATE_NONE_FREE_ODD_FIRST;
+			break;
+		  case TX_STATE_ODD_FREE:
+			b++;
+			next = TX_STATE_NONE_FREE_EVEN_FIRST;
+			break;
+		  default:
+			return;
+		}
+		if (tx_ref[endpoint].remaining) {
+			tx_ref_arm(endpoint, b);
 		} else {
-			tx_last[endpoint]->next = packet;
+			packet = usb_queue_get(&tx_queue[endpoint]);
+			if (!packet) return;
+			b->addr = packet->buf;
+			b->desc = BDT_DESC(packet->len, ((uint32_t)b & 8) ? DATA1 : DATA0);
 		}
-		tx_last[endpoint] = packet;
-		__enable_irq();
-		return;
+		tx_state[endpoint] = next;
+		b = &table[index(endpoint + 1, TX, EVEN)];
 	}
-	tx_state[endpoint] = next;
-	b->addr = packet->buf;
-	b->desc = BDT_DESC(packet->len, ((uint32_t)b & 8) ? DATA1 : DATA0);
-	__enable_irq();
 }
 
 
@@ -681,6 +920,51 @@ void usb_tx(uint32_t endpoint, usb_packet_t *packet)
 
 
 
+// Queue an application buffer for transmission by reference.  The USB
+// DMA reads it directly, packet_size bytes at a time, so no usb_packet_t
+// memory is used and nothing is copied.  The buffer must stay untouched
+// until the callback runs (from the USB interrupt) or usb_tx_ref_busy()
+// returns 0.  Data already queued with usb_tx() must have drained first,
+// and anything queued with usb_tx() afterwards is sent after the buffer.
+// Returns 0 if the buffer was queued, -1 if the endpoint is busy.
+int usb_tx_ref(uint32_t endpoint, const void *buffer, uint32_t len,
+	uint32_t packet_size, usb_tx_ref_callback_t callback)
+{
+	tx_ref_t *ref;
+	uint32_t kick;
+
+	endpoint--;
+	if (endpoint >= NUM_ENDPOINTS || len == 0) return -1;
+	ref = &tx_ref[endpoint];
+	// claim the endpoint's zero-copy slot
+	do {
+		if (__ldrexw((volatile uint32_t *)&ref->buffer) || usb_queue_count(&tx_queue[endpoint])) {
+			__clrex();
+			return -1;
+		}
+	} while (__strexw((uint32_t)buffer, (volatile uint32_t *)&ref->buffer));
+	ref->data = buffer;
+	ref->packet_size = packet_size;
+	ref->callback = callback;
+	// setting remaining hands the buffer to usb_isr, so it must be last
+	asm volatile("" ::: "memory");
+	ref->remaining = len;
+	do {
+		kick = __ldrexw(&tx_kick);
+	} while (__strexw(kick | (1 << endpoint), &tx_kick));
+	NVIC_SET_PENDING(IRQ_USBOTG);
+	return 0;
+}
+
+int usb_tx_ref_busy(uint32_t endpoint)
+{
+	endpoint--;
+	if (endpoint >= NUM_ENDPOINTS) return 0;
+	return tx_ref[endpoint].buffer != NULL;
+}
+
+
+
 void _reboot_Teensyduino_(void)
 {
 	// TODO: initialize R0 with a code....
@@ -689,7 +973,7 @@ void _reboot_Teensyduino_(void)
 
 
 
-void usb_isr(void)
+static void usb_isr_service(void)
 {
 	uint8_t status, stat, t;
 
@@ -698,6 +982,16 @@ void usb_isr(void)
 	//serial_phex(status);
 	//serial_print("\n");
 	restart:
+	// load packets queued by usb_tx() or usb_tx_ref() since last time
+	if (tx_kick) {
+		uint32_t kick, i;
+		do {
+			kick = __ldrexw(&tx_kick);
+		} while (__strexw(0, &tx_kick));
+		for (i=0; i < NUM_ENDPOINTS; i++) {
+			if (kick & (1 << i)) usb_tx_fill(i);
+		}
+	}
 	status = USB0_ISTAT;
 
 	if ((status & USB_INTEN_SOFTOKEN /* 04 */ )) {
@@ -724,6 +1018,9 @@ void usb_isr(void)
 #ifdef MIDI_INTERFACE
                         usb_midi_flush_output();
 #endif
+#ifdef AUDIO_INTERFACE
+			usb_audio_sof();
+#endif
 #ifdef FLIGHTSIM_INTERFACE
 			usb_flightsim_flush_callback();
 #endif
@@ -756,70 +1053,54 @@ void usb_isr(void)
 #endif
 			endpoint--;	// endpoint is index to zero-based arrays
 
+#ifdef AUDIO_INTERFACE
+			if (endpoint == AUDIO_RX_ENDPOINT - 1) {
+				usb_audio_receive_callback(b->addr, b->desc >> 16);
+				b->desc = (AUDIO_RX_SIZE << 16) | BDT_OWN;
+			} else if (endpoint == AUDIO_TX_ENDPOINT - 1) {
+				b->desc = (usb_audio_transmit_callback(b->addr) << 16) | BDT_OWN;
+			} else if (endpoint == AUDIO_SYNC_ENDPOINT - 1) {
+				b->desc = (usb_audio_sync_callback(b->addr) << 16) | BDT_OWN;
+			} else
+#endif
 			if (stat & 0x08) { // transmit
-				usb_free(packet);
-				packet = tx_first[endpoint];
-				if (packet) {
-					//serial_print("tx packet\n");
-					tx_first[endpoint] = packet->next;
-					b->addr = packet->buf;
-					switch (tx_state[endpoint]) {
-					  case TX_STATE_BOTH_FREE_EVEN_FIRST:
-						tx_state[endpoint] = TX_STATE_ODD_FREE;
-						break;
-					  case TX_STATE_BOTH_FREE_ODD_FIRST:
-						tx_state[endpoint] = TX_STATE_EVEN_FREE;
-						break;
-					  case TX_STATE_EVEN_FREE:
-						tx_state[endpoint] = TX_STATE_NONE_FREE_ODD_FIRST;
-						break;
-					  case TX_STATE_ODD_FREE:
-						tx_state[endpoint] = TX_STATE_NONE_FREE_EVEN_FIRST;
-						break;
-					  default:
-						break;
+				if (tx_ref_bdt[endpoint] & TX_REF_BDT_BANK(b)) {
+					// part of a zero-copy buffer, nothing to free
+					tx_ref_bdt[endpoint] &= ~TX_REF_BDT_BANK(b);
+					if (!tx_ref[endpoint].remaining && !tx_ref_bdt[endpoint]) {
+						tx_ref_done(endpoint);
 					}
-					b->desc = BDT_DESC(packet->len, ((uint32_t)b & 8) ? DATA1 : DATA0);
 				} else {
-					//serial_print("tx no packet\n");
-					switch (tx_state[endpoint]) {
-					  case TX_STATE_BOTH_FREE_EVEN_FIRST:
-					  case TX_STATE_BOTH_FREE_ODD_FIRST:
-						break;
-					  case TX_STATE_EVEN_FREE:
-						tx_state[endpoint] = TX_STATE_BOTH_FREE_EVEN_FIRST;
-						break;
-					  case TX_STATE_ODD_FREE:
-						tx_state[endpoint] = TX_STATE_BOTH_FREE_ODD_FIRST;
-						break;
-					  default:
-						tx_state[endpoint] = ((uint32_t)b & 8) ?
-						  TX_STATE_ODD_FREE : TX_STATE_EVEN_FREE;
-						break;
-					}
+					usb_free(packet);
+				}
+				switch (tx_state[endpoint]) {
+				  case TX_STATE_BOTH_FREE_EVEN_FIRST:
+				  case TX_STATE_BOTH_FREE_ODD_FIRST:
+					break;
+				  case TX_STATE_EVEN_FREE:
+					tx_state[endpoint] = TX_STATE_BOTH_FREE_EVEN_FIRST;
+					break;
+				  case TX_STATE_ODD_FREE:
+					tx_state[endpoint] = TX_STATE_BOTH_FREE_ODD_FIRST;
+					break;
+				  default:
+					tx_state[endpoint] = ((uint32_t)b & 8) ?
+					  TX_STATE_ODD_FREE : TX_STATE_EVEN_FREE;
+					break;
 				}
+				usb_tx_fill(endpoint);
 			} else { // receive
 				packet->len = b->desc >> 16;
 				if (packet->len > 0) {
 					packet->index = 0;
 					packet->next = NULL;
-					if (rx_first[endpoint] == NULL) {
-						//serial_print("rx 1st, epidx=");
-						//serial_phex(endpoint);
-						//serial_print(", packet=");
-						//serial_phex32((uint32_t)packet);
-						//serial_print("\n");
-						rx_first[endpoint] = packet;
-					} else {
-						//serial_print("rx Nth, epidx=");
-						//serial_phex(endpoint);
-						//serial_print(", packet=");
-						//serial_phex32((uint32_t)packet);
-						//serial_print("\n");
-						rx_last[endpoint]->next = packet;
-					}
-					rx_last[endpoint] = packet;
-					usb_rx_byte_count_data[endpoint] += packet->len;
+					//serial_print("rx, epidx=");
+					//serial_phex(endpoint);
+					//serial_print(", packet=");
+					//serial_phex32((uint32_t)packet);
+					//serial_print("\n");
+					usb_rx_byte_count_add(endpoint, packet->len);
+					usb_queue_put(&rx_queue[endpoint], packet);
 					// TODO: implement a per-endpoint maximum # of allocated packets
 					// so a flood of incoming data on 1 endpoint doesn't starve
 					// the others if the user isn't reading it regularly
@@ -910,6 +1191,15 @@ void usb_isr(void)
 
 }
 
+void usb_isr(void)
+{
+	uint32_t start = prof_start();
+
+	usb_isr_service();
+	event_set(EVENT_USB);
+	prof_end(PROF_USB_ISR, start);
+}
+
 
 
 void usb_init(void)
@@ -50,11 +50,28 @@ usb_packet_t *usb_rx(uint32_t endpoint);
 uint32_t usb_tx_byte_count(uint32_t endpoint);
 uint32_t usb_tx_packet_count(uint32_t endpoint);
 void usb_tx(uint32_t endpoint, usb_packet_t *packet);
+void usb_tx_multi(uint32_t endpoint, usb_packet_t **packets, uint32_t count);
 void usb_tx_isr(uint32_t endpoint, usb_packet_t *packet);
 
+typedef void (*usb_tx_ref_callback_t)(const void *buffer);
+int usb_tx_ref(uint32_t endpoint, const void *buffer, uint32_t len,
+	uint32_t packet_size, usb_tx_ref_callback_t callback);
+int usb_tx_ref_busy(uint32_t endpoint);
+
+// When a stream sends a partial transmit packet, see usb_serial_flush_mode()
+#define USB_FLUSH_TIMER		0 // after param ms with no writes (0 = 5 ms)
+#define USB_FLUSH_IMMEDIATE	1 // at the end of every write
+#define USB_FLUSH_THRESHOLD	2 // once param bytes are waiting, else on end of message
+
+// Nonzero once msec have gone by since start (a millis() value) while a
+// stream waits for a free transmit packet.  Counted in time rather than
+// loop passes, since yield() sleeps until the next interrupt and one pass
+// can take up to a millisecond.
+#define usb_tx_timed_out(start, msec) ((millis() - (start)) > (msec))
+
 extern volatile uint8_t usb_configuration;
 
-extern uint16_t usb_rx_byte_count_data[NUM_ENDPOINTS];
+extern volatile uint16_t usb_rx_byte_count_data[NUM_ENDPOINTS];
 static inline uint32_t usb_rx_byte_count(uint32_t endpoint) __attribute__((always_inline));
 static inline uint32_t usb_rx_byte_count(uint32_t endpoint)
 {
@@ -70,6 +87,18 @@ extern volatile uint8_t usb_cdc_transmit_flush_timer;
 extern void usb_serial_flush_callback(void);
 #endif
 
+#ifdef AUDIO_INTERFACE
+extern uint8_t usb_audio_receive_buffer[2][AUDIO_RX_SIZE];
+extern uint8_t usb_audio_transmit_buffer[2][AUDIO_TX_SIZE];
+extern uint8_t usb_audio_sync_buffer[2][4];
+extern volatile uint8_t usb_audio_receive_setting;
+extern volatile uint8_t usb_audio_transmit_setting;
+extern void usb_audio_receive_callback(const uint8_t *buf, uint32_t len);
+extern uint32_t usb_audio_transmit_callback(uint8_t *buf);
+extern uint32_t usb_audio_sync_callback(uint8_t *buf);
+extern void usb_audio_sof(void);
+#endif
+
 #ifdef SEREMU_INTERFACE
 extern volatile uint8_t usb_seremu_transmit_flush_timer;
 extern void usb_seremu_flush_callback(void);
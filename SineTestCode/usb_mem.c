@@ -36,7 +36,49 @@
 __attribute__ ((section(".usbbuffers"), used))
 unsigned char usb_buffer_memory[NUM_USB_BUFFERS * sizeof(usb_packet_t)];
 
-static uint32_t usb_buffer_available = 0xFFFFFFFF;
+// Two level bitmap: one bit per buffer (set = free), 32 buffers per word,
+// plus a summary word with a bit set for every word that may still have a
+// free buffer.  Allocation is two CLZ instructions no matter how big the
+// pool is.  Bits past NUM_USB_BUFFERS in the last word are left set; they
+// can only be found once every real buffer is taken, which is checked for.
+//
+// Both words are updated with LDREX/STREX rather than by masking
+// interrupts, so usb_malloc/usb_free never add latency to the I2S
+// interrupt.  The summary is only a hint: usb_free sets the buffer bit
+// before the summary bit, and usb_malloc re-checks a word after clearing
+// its summary bit, so a word with free buffers never stays hidden.
+#define USB_MEM_WORDS ((NUM_USB_BUFFERS + 31) / 32)
+
+#if NUM_USB_BUFFERS > 1024
+#error "usb_mem supports at most 1024 buffers (32 bitmap words)"
+#endif
+
+static volatile uint32_t usb_buffer_available[USB_MEM_WORDS] = {
+	[0 ... USB_MEM_WORDS - 1] = 0xFFFFFFFF
+};
+static volatile uint32_t usb_buffer_summary = 0xFFFFFFFF << (32 - USB_MEM_WORDS);
+
+static inline void summary_set(uint32_t mask)
+{
+	uint32_t summary;
+
+	do {
+		summary = __ldrexw(&usb_buffer_summary);
+	} while (__strexw(summary | mask, &usb_buffer_summary));
+}
+
+// word w was seen empty, drop it from the summary
+static void summary_clear(uint32_t w)
+{
+	uint32_t summary, mask = 0x80000000 >> w;
+
+	do {
+		summary = __ldrexw(&usb_buffer_summary);
+	} while (__strexw(summary & ~mask, &usb_buffer_summary));
+	// a buffer freed since we looked may have set its summary bit
+	// before we cleared it
+	if (usb_buffer_available[w]) summary_set(mask);
+}
 
 // use bitmask and CLZ instruction to implement fast free list
 // http://www.archivum.info/gnu.gcc.help/2006-08/00148/Re-GCC-Inline-Assembly.html
@@ -45,23 +87,33 @@ static uint32_t usb_buffer_available = 0xFFFFFFFF;
 
 usb_packet_t * usb_malloc(void)
 {
-	unsigned int n, avail;
+	unsigned int n, w, avail, summary;
 	uint8_t *p;
 
-	__disable_irq();
-	avail = usb_buffer_available;
-	n = __builtin_clz(avail); // clz = count leading zeros
-	if (n >= NUM_USB_BUFFERS) {
-		__enable_irq();
-		return NULL;
+	while (1) {
+		summary = usb_buffer_summary;
+		if (!summary) return NULL;
+		w = __builtin_clz(summary); // first word with a free buffer
+		avail = __ldrexw(&usb_buffer_available[w]);
+		if (!avail) {
+			__clrex();
+			summary_clear(w);
+			continue;
+		}
+		n = __builtin_clz(avail); // clz = count leading zeros
+		if ((w << 5) + n >= NUM_USB_BUFFERS) {
+			__clrex();
+			return NULL;
+		}
+		avail &= ~(0x80000000 >> n);
+		if (__strexw(avail, &usb_buffer_available[w]) == 0) break;
 	}
+	if (!avail) summary_clear(w);
 	//serial_print("malloc:");
 	//serial_phex(n);
 	//serial_print("\n");
 
-	usb_buffer_available = avail & ~(0x80000000 >> n);
-	__enable_irq();
-	p = usb_buffer_memory + (n * sizeof(usb_packet_t));
+	p = usb_buffer_memory + (((w << 5) + n) * sizeof(usb_packet_t));
 	//serial_print("malloc:");
 	//serial_phex32((int)p);
 	//serial_print("\n");
@@ -76,7 +128,7 @@ extern void usb_rx_memory(usb_packet_t *packet);
 
 void usb_free(usb_packet_t *p)
 {
-	unsigned int n, mask;
+	unsigned int n, mask, avail;
 
 	//serial_print("free:");
 	n = ((uint8_t *)p - usb_buffer_memory) / sizeof(usb_packet_t);
@@ -94,13 +146,59 @@ void usb_free(usb_packet_t *p)
 		return;
 	}
 
-	mask = (0x80000000 >> n);
-	__disable_irq();
-	usb_buffer_available |= mask;
-	__enable_irq();
+	mask = (0x80000000 >> (n & 31));
+	do {
+		avail = __ldrexw(&usb_buffer_available[n >> 5]);
+	} while (__strexw(avail | mask, &usb_buffer_available[n >> 5]));
+	summary_set(0x80000000 >> (n >> 5));
 
 	//serial_print("free:");
 	//serial_phex32((int)p);
 	//serial_print("\n");
 }
 
+// Copy to/from packet buffers a word (or halfword) at a time when the
+// source and destination line up, instead of a byte at a time.
+void usb_memcpy(void *dst, const void *src, uint32_t len)
+{
+	uint8_t *d = (uint8_t *)dst;
+	const uint8_t *s = (const uint8_t *)src;
+
+	if ((((uint32_t)d ^ (uint32_t)s) & 3) == 0) {
+		while (((uint32_t)d & 3) && len) {
+			*d++ = *s++;
+			len--;
+		}
+		while (len >= 16) {
+			uint32_t a = ((const uint32_t *)s)[0];
+			uint32_t b = ((const uint32_t *)s)[1];
+			uint32_t c = ((const uint32_t *)s)[2];
+			uint32_t e = ((const uint32_t *)s)[3];
+			((uint32_t *)d)[0] = a;
+			((uint32_t *)d)[1] = b;
+			((uint32_t *)d)[2] = c;
+			((uint32_t *)d)[3] = e;
+			d += 16;
+			s += 16;
+			len -= 16;
+		}
+		while (len >= 4) {
+			*(uint32_t *)d = *(const uint32_t *)s;
+			d += 4;
+			s += 4;
+			len -= 4;
+		}
+	} else if ((((uint32_t)d ^ (uint32_t)s) & 1) == 0) {
+		if (((uint32_t)d & 1) && len) {
+			*d++ = *s++;
+			len--;
+		}
+		while (len >= 2) {
+			*(uint16_t *)d = *(const uint16_t *)s;
+			d += 2;
+			s += 2;
+			len -= 2;
+		}
+	}
+	while (len--) *d++ = *s++;
+}
@@ -46,6 +46,7 @@ extern "C" {
 
 usb_packet_t * usb_malloc(void);
 void usb_free(usb_packet_t *p);
+void usb_memcpy(void *dst, const void *src, uint32_t len);
 
 #ifdef __cplusplus
 }
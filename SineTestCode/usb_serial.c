@@ -32,7 +32,8 @@
 #include "usb_serial.h"
 #include "core_pins.h" // for yield()
 //#include "HardwareSerial.h"
-#include <string.h> // for memcpy()
+#include "fmt.h"
+#include "usb_mem.h"
 
 // defined by usb_dev.h -> usb_desc.h
 #if defined(CDC_STATUS_INTERFACE) && defined(CDC_DATA_INTERFACE)
@@ -47,6 +48,9 @@ static volatile uint8_t tx_noautoflush=0;
 
 #define TRANSMIT_FLUSH_TIMEOUT	5   /* in milliseconds */
 
+static uint8_t tx_flush_mode=USB_FLUSH_TIMER;
+static uint8_t tx_flush_param=TRANSMIT_FLUSH_TIMEOUT;
+
 // get the next character, or -1 if nothing received
 int usb_serial_getchar(void)
 {
@@ -109,7 +113,7 @@ int usb_serial_read(void *buffer, uint32_t size)
 		}
 		qty = rx_packet->len - rx_packet->index;
 		if (qty > size) qty = size;
-		memcpy(p, rx_packet->buf + rx_packet->index, qty);
+		usb_memcpy(p, rx_packet->buf + rx_packet->index, qty);
 		p += qty;
 		count += qty;
 		size -= qty;
@@ -122,6 +126,51 @@ int usb_serial_read(void *buffer, uint32_t size)
 	return count;
 }
 
+// read characters up to a '\r' or '\n', waiting until one arrives or
+// max_len characters have been stored.  The end of line character is
+// consumed but not stored.  Each packet is scanned in place instead of
+// going through usb_serial_getchar() for every character.  Returns the
+// number of characters stored.
+int usb_serial_readline(char *buffer, uint32_t max_len)
+{
+	const uint8_t *p, *end;
+	uint32_t count=0;
+	uint8_t c;
+
+	while (count < max_len) {
+		if (!rx_packet) {
+			if (usb_configuration) rx_packet = usb_rx(CDC_RX_ENDPOINT);
+			if (!rx_packet) {
+				yield();
+				continue;
+			}
+			if (rx_packet->index >= rx_packet->len) {
+				usb_free(rx_packet);
+				rx_packet = NULL;
+				continue;
+			}
+		}
+		p = rx_packet->buf + rx_packet->index;
+		end = rx_packet->buf + rx_packet->len;
+		if ((uint32_t)(end - p) > max_len - count) end = p + (max_len - count);
+		while (p < end) {
+			c = *p++;
+			if (c == '\r' || c == '\n') {
+				end = NULL;
+				break;
+			}
+			buffer[count++] = c;
+		}
+		rx_packet->index = p - rx_packet->buf;
+		if (rx_packet->index >= rx_packet->len) {
+			usb_free(rx_packet);
+			rx_packet = NULL;
+		}
+		if (!end) break;
+	}
+	return count;
+}
+
 // discard any buffered input
 void usb_serial_flush_input(void)
 {
@@ -147,14 +196,6 @@ void usb_serial_flush_input(void)
 // software.  If it's too long, we stall the user's program when no software is running.
 #define TX_TIMEOUT_MSEC 70
 
-#if F_CPU == 96000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 596)
-#elif F_CPU == 48000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 428)
-#elif F_CPU == 24000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 262)
-#endif
-
 // When we've suffered the transmit timeout, don't wait again until the computer
 // begins accepting data.  If no software is running to receive, we'll just discard
 // data as rapidly as Serial.print() can generate it, until there's something to
@@ -169,53 +210,193 @@ int usb_serial_putchar(uint8_t c)
 }
 
 
-int usb_serial_write(const void *buffer, uint32_t size)
+// Full packets are handed to usb_tx_multi() this many at a time
+#define TX_BATCH 4
+
+// wait for a free transmit packet.  0 returned on success, -1 on error
+static int tx_packet_alloc(void)
 {
-	uint32_t len;
-	uint32_t wait_count;
+	uint32_t wait_start = millis();
+
+	while (1) {
+		if (!usb_configuration) {
+			tx_noautoflush = 0;
+			return -1;
+		}
+		if (usb_tx_packet_count(CDC_TX_ENDPOINT) < TX_PACKET_LIMIT) {
+			tx_noautoflush = 1;
+			tx_packet = usb_malloc();
+			if (tx_packet) break;
+			tx_noautoflush = 0;
+		}
+		if (usb_tx_timed_out(wait_start, TX_TIMEOUT_MSEC) || transmit_previous_timeout) {
+			transmit_previous_timeout = 1;
+			return -1;
+		}
+		yield();
+	}
+	return 0;
+}
+
+// Choose when a partially filled packet is sent.  USB_FLUSH_TIMER (the
+// default) waits for param ms without writes, which suits a console.
+// USB_FLUSH_IMMEDIATE sends at the end of every write, so a command
+// reply goes out in the next USB frame.  USB_FLUSH_THRESHOLD waits until
+// param bytes are buffered, and otherwise only sends on
+// usb_serial_end_message() or usb_serial_flush_output(), so bulk data
+// always travels in full packets.
+void usb_serial_flush_mode(uint8_t mode, uint8_t param)
+{
+	tx_noautoflush = 1;
+	usb_cdc_transmit_flush_timer = 0;
+	if (mode == USB_FLUSH_TIMER && param == 0) param = TRANSMIT_FLUSH_TIMEOUT;
+	if (mode == USB_FLUSH_THRESHOLD && (param == 0 || param > CDC_TX_SIZE)) {
+		param = CDC_TX_SIZE;
+	}
+	tx_flush_mode = mode;
+	tx_flush_param = param;
+	if (tx_packet && mode == USB_FLUSH_TIMER) usb_cdc_transmit_flush_timer = param;
+	tx_noautoflush = 0;
+}
+
+// send the partial packet now
+static void tx_send_partial(void)
+{
+	usb_cdc_transmit_flush_timer = 0;
+	tx_packet->len = tx_packet->index;
+	usb_tx(CDC_TX_ENDPOINT, tx_packet);
+	tx_packet = NULL;
+}
+
+// apply the flush policy to whatever a write left in tx_packet
+static void tx_write_done(void)
+{
+	if (tx_packet) {
+		switch (tx_flush_mode) {
+		  case USB_FLUSH_IMMEDIATE:
+			tx_send_partial();
+			break;
+		  case USB_FLUSH_THRESHOLD:
+			if (tx_packet->index >= tx_flush_param) tx_send_partial();
+			break;
+		  default:
+			usb_cdc_transmit_flush_timer = tx_flush_param;
+		}
+	}
+	tx_noautoflush = 0;
+}
+
+// Full packets are collected and queued TX_BATCH at a time, so a long
+// write costs one queue update and one USB interrupt per batch rather
+// than per packet.  The batch is always sent before waiting for memory.
+static int tx_write(const void *buffer, uint32_t size)
+{
+	usb_packet_t *batch[TX_BATCH];
+	uint32_t len, nbatch=0;
 	const uint8_t *src = (const uint8_t *)buffer;
-	uint8_t *dest;
 
 	tx_noautoflush = 1;
 	while (size > 0) {
 		if (!tx_packet) {
-			wait_count = 0;
-			while (1) {
-				if (!usb_configuration) {
-					tx_noautoflush = 0;
-					return -1;
-				}
-				if (usb_tx_packet_count(CDC_TX_ENDPOINT) < TX_PACKET_LIMIT) {
-					tx_noautoflush = 1;
-					tx_packet = usb_malloc();
-					if (tx_packet) break;
-					tx_noautoflush = 0;
-				}
-				if (++wait_count > TX_TIMEOUT || transmit_previous_timeout) {
-					transmit_previous_timeout = 1;
-					return -1;
-				}
-				yield();
+			if (nbatch < TX_BATCH && usb_configuration
+			  && usb_tx_packet_count(CDC_TX_ENDPOINT) + nbatch < TX_PACKET_LIMIT) {
+				tx_packet = usb_malloc();
+			}
+			if (!tx_packet) {
+				usb_tx_multi(CDC_TX_ENDPOINT, batch, nbatch);
+				nbatch = 0;
+				if (tx_packet_alloc()) return -1;
 			}
 		}
 		transmit_previous_timeout = 0;
 		len = CDC_TX_SIZE - tx_packet->index;
 		if (len > size) len = size;
-		dest = tx_packet->buf + tx_packet->index;
+		usb_memcpy(tx_packet->buf + tx_packet->index, src, len);
 		tx_packet->index += len;
+		src += len;
 		size -= len;
-		while (len-- > 0) *dest++ = *src++;
 		if (tx_packet->index >= CDC_TX_SIZE) {
 			tx_packet->len = CDC_TX_SIZE;
-			usb_tx(CDC_TX_ENDPOINT, tx_packet);
+			batch[nbatch++] = tx_packet;
 			tx_packet = NULL;
 		}
-		usb_cdc_transmit_flush_timer = TRANSMIT_FLUSH_TIMEOUT;
 	}
+	usb_tx_multi(CDC_TX_ENDPOINT, batch, nbatch);
+	return 0;
+}
+
+int usb_serial_write(const void *buffer, uint32_t size)
+{
+	if (tx_write(buffer, size)) return -1;
+	tx_write_done();
+	return 0;
+}
+
+// write num lines of "a[i],b[i]\r\n", formatted directly into the
+// transmit packets.  0 returned on success, -1 on error
+int usb_serial_write_csv(const int32_t *a, const int32_t *b, uint32_t num)
+{
+	char line[FMT_CSV_LINE_MAX_LEN];
+	uint32_t len, n;
+
+	tx_noautoflush = 1;
+	while (num > 0) {
+		if (!tx_packet) {
+			if (tx_packet_alloc()) return -1;
+		}
+		transmit_previous_timeout = 0;
+		n = num;
+		len = fmt_csv_block((char *)tx_packet->buf + tx_packet->index,
+			CDC_TX_SIZE - tx_packet->index, a, b, &n);
+		tx_packet->index += len;
+		a += n;
+		b += n;
+		num -= n;
+		if (num > 0) {
+			// the next line may not fit in what's left of this
+			// packet, so let it straddle into the next one
+			len = fmt_csv_line(line, *a++, *b++);
+			num--;
+			if (tx_write(line, len)) return -1;
+		}
+	}
+	tx_write_done();
+	return 0;
+}
+
+// Send a buffer by reference instead of copying it into usb_packet_t
+// memory.  Returns as soon as the buffer is queued; it must not be
+// modified until callback runs (from the USB interrupt) or
+// usb_serial_write_nocopy_busy() returns 0.  Anything written earlier
+// goes out first.  0 returned on success, -1 on error
+int usb_serial_write_nocopy(const void *buffer, uint32_t size,
+	void (*callback)(const void *buffer))
+{
+	uint32_t wait_start = millis();
+
+	if (size == 0) return 0;
+	tx_noautoflush = 1;
+	// send the partial packet so ordering is kept
+	if (tx_packet) tx_send_partial();
 	tx_noautoflush = 0;
+	// the previous buffer and any queued packets must drain first
+	while (usb_tx_ref(CDC_TX_ENDPOINT, buffer, size, CDC_TX_SIZE, callback)) {
+		if (!usb_configuration) return -1;
+		if (usb_tx_timed_out(wait_start, TX_TIMEOUT_MSEC) || transmit_previous_timeout) {
+			transmit_previous_timeout = 1;
+			return -1;
+		}
+		yield();
+	}
+	transmit_previous_timeout = 0;
 	return 0;
 }
 
+int usb_serial_write_nocopy_busy(void)
+{
+	return usb_tx_ref_busy(CDC_TX_ENDPOINT);
+}
+
 void usb_serial_flush_output(void)
 {
 	if (!usb_configuration) return;
@@ -237,6 +418,17 @@ void usb_serial_flush_output(void)
 	tx_noautoflush = 0;
 }
 
+// Mark the end of a message (a command reply, say): send what is
+// buffered now, whatever the flush mode.  Unlike flush_output, nothing
+// is sent if the buffer is empty.
+void usb_serial_end_message(void)
+{
+	if (!usb_configuration) return;
+	tx_noautoflush = 1;
+	if (tx_packet) tx_send_partial();
+	tx_noautoflush = 0;
+}
+
 void usb_serial_flush_callback(void)
 {
 	if (tx_noautoflush) return;
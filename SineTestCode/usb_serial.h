@@ -31,7 +31,7 @@
 #ifndef USBserial_h_
 #define USBserial_h_
 
-#if defined(USB_SERIAL) || defined(USB_SERIAL_HID)
+#if defined(USB_SERIAL) || defined(USB_SERIAL_HID) || defined(USB_SERIAL_AUDIO)
 
 #include <inttypes.h>
 
@@ -43,10 +43,17 @@ int usb_serial_getchar(void);
 int usb_serial_peekchar(void);
 int usb_serial_available(void);
 int usb_serial_read(void *buffer, uint32_t size);
+int usb_serial_readline(char *buffer, uint32_t max_len);
 void usb_serial_flush_input(void);
 int usb_serial_putchar(uint8_t c);
 int usb_serial_write(const void *buffer, uint32_t size);
+int usb_serial_write_csv(const int32_t *a, const int32_t *b, uint32_t num);
+int usb_serial_write_nocopy(const void *buffer, uint32_t size,
+	void (*callback)(const void *buffer));
+int usb_serial_write_nocopy_busy(void);
 void usb_serial_flush_output(void);
+void usb_serial_flush_mode(uint8_t mode, uint8_t param);
+void usb_serial_end_message(void);
 extern uint32_t usb_cdc_line_coding[2];
 extern volatile uint8_t usb_cdc_line_rtsdtr;
 extern volatile uint8_t usb_cdc_transmit_flush_timer;
@@ -103,5 +110,5 @@ extern usb_serial_class Serial;
 
 #endif // __cplusplus
 
-#endif // USB_SERIAL || USB_SERIAL_HID
+#endif // USB_SERIAL || USB_SERIAL_HID || USB_SERIAL_AUDIO
 #endif // USBserial_h_
@@ -28,5 +28,9 @@
  * SOFTWARE.
  */
 
+#include "event.h"
+
+// Nothing else to do while waiting, so sleep until the next interrupt.
+// sched.c replaces this with one that runs background jobs first.
 void yield(void) __attribute__ ((weak));
-void yield(void) {};
+void yield(void) { event_idle(); };